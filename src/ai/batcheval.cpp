@@ -0,0 +1,229 @@
+#include "batcheval.hpp"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/* The vector operations the kernel needs, on lanes of 32 bit integers.
+ * Comparisons return all ones for true, so masks combine with And.
+ */
+struct ScalarLanes
+{
+    typedef int32_t V;
+    static constexpr int WIDTH = 1;
+
+    static V Load(const uint32_t* p) { return int32_t(*p); }
+    static void Store(int32_t* p, V v) { *p = v; }
+    static V Set(int32_t x) { return x; }
+
+    static V Add(V a, V b) { return a + b; }
+    static V Sub(V a, V b) { return a - b; }
+    static V And(V a, V b) { return a & b; }
+    static V Or(V a, V b) { return a | b; }
+    static V Xor(V a, V b) { return a ^ b; }
+    static V AndNot(V a, V b) { return ~a & b; }
+    template <int N> static V Shl(V a) { return int32_t(uint32_t(a) << N); }
+    template <int N> static V Shr(V a) { return int32_t(uint32_t(a) >> N); }
+
+    static V Eq(V a, V b) { return -int32_t(a == b); }
+    static V Gt(V a, V b) { return -int32_t(a > b); }
+    static V Max(V a, V b) { return max(a, b); }
+    static V Min(V a, V b) { return min(a, b); }
+    static V Abs(V a) { return abs(a); }
+    static V Select(V mask, V a, V b) { return mask ? a : b; }
+
+    static V Popcount(V a) { return popcount(uint32_t(a)); }
+    static V Log2(V a) { return 31 - countl_zero(uint32_t(a)); }     // a > 0
+    static V Pow2(V a) { return int32_t(1u << a); }
+};
+
+#if defined(__SSE2__)
+struct Sse2Lanes
+{
+    typedef __m128i V;
+    static constexpr int WIDTH = 4;
+
+    static V Load(const uint32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+    static void Store(int32_t* p, V v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+    static V Set(int32_t x) { return _mm_set1_epi32(x); }
+
+    static V Add(V a, V b) { return _mm_add_epi32(a, b); }
+    static V Sub(V a, V b) { return _mm_sub_epi32(a, b); }
+    static V And(V a, V b) { return _mm_and_si128(a, b); }
+    static V Or(V a, V b) { return _mm_or_si128(a, b); }
+    static V Xor(V a, V b) { return _mm_xor_si128(a, b); }
+    static V AndNot(V a, V b) { return _mm_andnot_si128(a, b); }
+    template <int N> static V Shl(V a) { return _mm_slli_epi32(a, N); }
+    template <int N> static V Shr(V a) { return _mm_srli_epi32(a, N); }
+
+    static V Eq(V a, V b) { return _mm_cmpeq_epi32(a, b); }
+    static V Gt(V a, V b) { return _mm_cmpgt_epi32(a, b); }
+    static V Select(V mask, V a, V b) { return Or(And(mask, a), AndNot(mask, b)); }
+    static V Max(V a, V b) { return Select(Gt(a, b), a, b); }
+    static V Min(V a, V b) { return Select(Gt(a, b), b, a); }
+
+    static V Abs(V a)
+    {
+        const V sign = _mm_srai_epi32(a, 31);
+        return Sub(Xor(a, sign), sign);
+    }
+
+    // SWAR, SSE2 has no byte shuffle to look the nibbles up with
+    static V Popcount(V a)
+    {
+        a = Sub(a, And(Shr<1>(a), Set(0x55555555)));
+        a = Add(And(a, Set(0x33333333)), And(Shr<2>(a), Set(0x33333333)));
+        a = And(Add(a, Shr<4>(a)), Set(0x0f0f0f0f));
+        a = Add(a, Shr<8>(a));
+        a = Add(a, Shr<16>(a));
+        return And(a, Set(0x3f));
+    }
+
+    // Exponent of the float, exact below 2^24 and every mask here is
+    static V Log2(V a) { return Sub(Shr<23>(_mm_castps_si128(_mm_cvtepi32_ps(a))), Set(127)); }
+    static V Pow2(V a) { return _mm_cvttps_epi32(_mm_castsi128_ps(Shl<23>(Add(a, Set(127))))); }
+};
+#endif
+
+#if defined(__AVX2__)
+struct Avx2Lanes
+{
+    typedef __m256i V;
+    static constexpr int WIDTH = 8;
+
+    static V Load(const uint32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+    static void Store(int32_t* p, V v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+    static V Set(int32_t x) { return _mm256_set1_epi32(x); }
+
+    static V Add(V a, V b) { return _mm256_add_epi32(a, b); }
+    static V Sub(V a, V b) { return _mm256_sub_epi32(a, b); }
+    static V And(V a, V b) { return _mm256_and_si256(a, b); }
+    static V Or(V a, V b) { return _mm256_or_si256(a, b); }
+    static V Xor(V a, V b) { return _mm256_xor_si256(a, b); }
+    static V AndNot(V a, V b) { return _mm256_andnot_si256(a, b); }
+    template <int N> static V Shl(V a) { return _mm256_slli_epi32(a, N); }
+    template <int N> static V Shr(V a) { return _mm256_srli_epi32(a, N); }
+
+    static V Eq(V a, V b) { return _mm256_cmpeq_epi32(a, b); }
+    static V Gt(V a, V b) { return _mm256_cmpgt_epi32(a, b); }
+    static V Max(V a, V b) { return _mm256_max_epi32(a, b); }
+    static V Min(V a, V b) { return _mm256_min_epi32(a, b); }
+    static V Abs(V a) { return _mm256_abs_epi32(a); }
+    static V Select(V mask, V a, V b) { return _mm256_blendv_epi8(b, a, mask); }
+
+    // Nibbles looked up in a 16 entry table, then the four bytes of each lane summed
+    static V Popcount(V a)
+    {
+        const V table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const V nibble = _mm256_set1_epi8(0x0f);
+        const V bytes = _mm256_add_epi8(_mm256_shuffle_epi8(table, And(a, nibble)),
+                                        _mm256_shuffle_epi8(table, And(_mm256_srli_epi16(a, 4), nibble)));
+        return _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, _mm256_set1_epi8(1)), _mm256_set1_epi16(1));
+    }
+
+    static V Log2(V a) { return Sub(Shr<23>(_mm256_castps_si256(_mm256_cvtepi32_ps(a))), Set(127)); }
+    static V Pow2(V a) { return _mm256_sllv_epi32(Set(1), a); }
+};
+#endif
+
+/* CalcHeuristics on WIDTH boards from first on, each lane replaying the
+ * column scan: the first filled row below the spawn rows gives the height,
+ * the cells left under it the holes, and XOR with the row above the
+ * transitions. The height carried to the next column drops to 0 after an
+ * empty column or one with its bottom two rows filled, as in the scan.
+ */
+static_assert(CONTOUR_DIGITS == 5, "MeasureLanes multiplies the contour index by shifting");
+
+template <typename L>
+static void MeasureLanes(const BoardBatch& batch, BatchHeuristics& features, int first)
+{
+    typedef typename L::V V;
+
+    const V zero = L::Set(0), one = L::Set(1);
+    const V rowsMask = L::Set(ROWS_MASK);
+    const V scannedRows = L::Set(ROWS_MASK & ~3u);
+    const V floorPair = L::Set(3);
+
+    V cols[BOARD_WIDTH];     // a plain array, std::array would drop the vector alignment
+    for (int x = 0; x < BOARD_WIDTH; ++x)
+        cols[x] = L::Load(&batch.cols[x][first]);
+
+    V holeCount = zero, aggrHeight = zero, maxHeight = zero, bumpiness = zero;
+    V rowTransition = zero, colTransition = zero, wellDepth = zero, additionalWell = L::Set(-1);
+    V lastColHeight = zero, prevHeight = zero, contourIndex = zero;
+
+    for (int x = 0; x < BOARD_WIDTH; ++x)
+    {
+        const V cells = L::And(cols[x], scannedRows);
+        const V empty = L::Eq(cells, zero);
+
+        // Lowest set bit is the top filled row, its float exponent the row index
+        const V top = L::Log2(L::And(cells, L::Sub(zero, cells)));
+        const V height = L::AndNot(empty, L::Sub(L::Set(BOARD_HEIGHT), top));
+
+        holeCount = L::Add(holeCount, L::Sub(height, L::Popcount(cells)));
+        colTransition = L::Add(colTransition, L::AndNot(empty,
+            L::Sub(L::Popcount(L::And(L::Xor(cells, L::template Shl<1>(cells)), rowsMask)), one)));
+
+        aggrHeight = L::Add(aggrHeight, height);
+        maxHeight = L::Max(maxHeight, height);
+
+        // Contour digits, each step saturated at CONTOUR_STEP, times CONTOUR_DIGITS as 4x + x
+        if (x > 0)
+        {
+            const V step = L::Min(L::Max(L::Sub(height, prevHeight), L::Set(-CONTOUR_STEP)), L::Set(CONTOUR_STEP));
+            contourIndex = L::Add(L::Add(L::template Shl<2>(contourIndex), contourIndex), L::Add(step, L::Set(CONTOUR_STEP)));
+        }
+        prevHeight = height;
+
+        if (x == 0) lastColHeight = height;
+        bumpiness = L::Add(bumpiness, L::AndNot(empty, L::Abs(L::Sub(height, lastColHeight))));
+        lastColHeight = L::Select(empty, lastColHeight, height);
+
+        const V drop = L::Or(empty, L::Eq(L::template Shr<BOARD_HEIGHT - 2>(cells), floorPair));
+        bumpiness = L::Add(bumpiness, L::And(drop, lastColHeight));
+        lastColHeight = L::AndNot(drop, lastColHeight);
+
+        // Open cells between filled neighbours or walls, counted up from right above the height
+        const V left = (x > 0) ? cols[x - 1] : rowsMask;
+        const V right = (x < BOARD_WIDTH - 1) ? cols[x + 1] : rowsMask;
+        const V open = L::And(L::AndNot(cols[x], L::And(left, right)), rowsMask);
+
+        const V start = L::Sub(L::Set(BOARD_HEIGHT - 1), lastColHeight);
+        const V closed = L::AndNot(open, L::Sub(L::Pow2(L::Add(start, one)), one));
+        const V depth = L::Select(L::Eq(closed, zero), L::Add(start, one), L::Sub(start, L::Log2(closed)));
+        const V isWell = L::Gt(depth, L::Set(2));
+
+        wellDepth = L::Max(wellDepth, L::And(isWell, depth));
+        additionalWell = L::Sub(additionalWell, isWell);
+
+        if (x > 0)
+            rowTransition = L::Add(rowTransition, L::Popcount(L::And(L::Xor(cols[x - 1], cols[x]), scannedRows)));
+    }
+
+    L::Store(&features.holeCount[first], holeCount);
+    L::Store(&features.aggrHeight[first], aggrHeight);
+    L::Store(&features.maxHeight[first], maxHeight);
+    L::Store(&features.bumpiness[first], bumpiness);
+    L::Store(&features.rowTransition[first], rowTransition);
+    L::Store(&features.colTransition[first], colTransition);
+    L::Store(&features.wellDepth[first], wellDepth);
+    L::Store(&features.additionalWell[first], additionalWell);
+    L::Store(&features.contourIndex[first], contourIndex);
+}
+
+#if defined(__AVX2__)
+typedef Avx2Lanes BatchLanes;
+#elif defined(__SSE2__)
+typedef Sse2Lanes BatchLanes;
+#else
+typedef ScalarLanes BatchLanes;
+#endif
+
+// The last step runs past count into lanes left from earlier batches, never read back
+void MeasureBatch(const BoardBatch& batch, BatchHeuristics& features)
+{
+    for (int first = 0; first < batch.count; first += BatchLanes::WIDTH)
+        MeasureLanes<BatchLanes>(batch, features, first);
+}
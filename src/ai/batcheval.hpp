@@ -0,0 +1,75 @@
+#ifndef BATCHEVAL_HPP
+#define BATCHEVAL_HPP
+
+#include "contour.hpp"
+#include "kernels.hpp"
+#include "movegen.hpp"
+
+// Boards measured together, 8 x 32 bits fill an AVX2 register
+constexpr int BATCH_LANES = 8;
+constexpr int BATCH_CAPACITY = (MAX_PLACEMENTS + BATCH_LANES - 1) / BATCH_LANES * BATCH_LANES;
+
+/* Every placement of one piece as column masks, structure of arrays:
+ * cols[x] holds column x of each board side by side, so one vector load
+ * reads the same column of several boards. The boards are taken with the
+ * piece locked in and before lines clear, as CalcHeuristics sees them.
+ */
+struct BoardBatch
+{
+    alignas(32) array<array<uint32_t, BATCH_CAPACITY>, BOARD_WIDTH> cols = {};
+    array<int, BATCH_CAPACITY> scores = {};         // CalcScore of each placement
+    array<int, BATCH_CAPACITY> tSpinSlotLines = {}; // only counted with a tSpinSetup weight
+    int count = 0;
+
+    void Clear() { count = 0; }
+
+    void Add(const ColumnMasks& board, BlockType type, const Placement& placement, int score, int tSpinLines)
+    {
+        for (int x = 0; x < BOARD_WIDTH; ++x)
+            cols[x][count] = board[x];
+        for (const Coord& mino : blockData[type][placement.rotation])
+            cols[placement.posX + mino.x][count] |= 1u << (placement.posY + mino.y);
+
+        scores[count] = score;
+        tSpinSlotLines[count] = tSpinLines;
+        count++;
+    }
+};
+
+// BoardHeuristics of a whole batch, one array per feature
+struct BatchHeuristics
+{
+    alignas(32) array<int32_t, BATCH_CAPACITY> holeCount;
+    alignas(32) array<int32_t, BATCH_CAPACITY> aggrHeight;
+    alignas(32) array<int32_t, BATCH_CAPACITY> maxHeight;
+    alignas(32) array<int32_t, BATCH_CAPACITY> bumpiness;
+    alignas(32) array<int32_t, BATCH_CAPACITY> rowTransition;
+    alignas(32) array<int32_t, BATCH_CAPACITY> colTransition;
+    alignas(32) array<int32_t, BATCH_CAPACITY> wellDepth;
+    alignas(32) array<int32_t, BATCH_CAPACITY> additionalWell;
+    alignas(32) array<int32_t, BATCH_CAPACITY> contourIndex;   // ContourIndex, looked up only when weighed
+
+    BoardHeuristics At(const BoardBatch& batch, int i) const
+    {
+        BoardHeuristics features;
+        features.holeCount = holeCount[i];
+        features.aggrHeight = aggrHeight[i];
+        features.maxHeight = maxHeight[i];
+        features.bumpiness = bumpiness[i];
+        features.rowTransition = rowTransition[i];
+        features.colTransition = colTransition[i];
+        features.wellDepth = wellDepth[i];
+        features.additionalWell = additionalWell[i];
+        features.tSpinSlotLines = batch.tSpinSlotLines[i];
+        return features;
+    }
+};
+
+/* CalcHeuristics for every board of the batch, numerically the same. Runs
+ * 8 boards per step with AVX2, 4 with SSE2, or one at a time otherwise,
+ * whichever the build targets. AVX2 is only used when the build asks for it
+ * (USE_AVX2), there is no check of the CPU at runtime.
+ */
+void MeasureBatch(const BoardBatch& batch, BatchHeuristics& features);
+
+#endif /* BATCHEVAL_HPP */
@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <bit>
+#include <vector>
+#include "core/block.hpp"
+#include "contour.hpp"
+
+// Longest run of steps under one piece, the horizontal I spans 3
+constexpr int MAX_WINDOW = 3;
+
+int ContourIndex(const array<int, BOARD_WIDTH>& heights)
+{
+    int index = 0;
+    for (int x = 0; x < CONTOUR_GAPS; ++x)
+        index = index * CONTOUR_DIGITS + clamp(heights[x + 1] - heights[x], -CONTOUR_STEP, CONTOUR_STEP) + CONTOUR_STEP;
+    return index;
+}
+
+/* Types taking each run of 1 to 3 steps, read as a number like the index.
+ * A piece lands cleanly where every column under it meets its lowest cell,
+ * so the steps under it must be the steps of its bottom. Bottoms with a
+ * step of 2 only ever meet a saturated digit, which may be steeper, and
+ * are left out.
+ */
+static array<vector<uint8_t>, MAX_WINDOW + 1> BuildWindows()
+{
+    array<vector<uint8_t>, MAX_WINDOW + 1> windows;
+    for (int length = 1, size = CONTOUR_DIGITS; length <= MAX_WINDOW; ++length, size *= CONTOUR_DIGITS)
+        windows[length].assign(size, 0);
+
+    for (int type = 0; type < BLOCK_TYPES; ++type)
+    {
+        for (const auto& minos : blockData[type])
+        {
+            array<int, TETROMINO_SIZE> bottom;
+            bottom.fill(-1);
+            int minCol = TETROMINO_SIZE, maxCol = 0;
+            for (const Coord& mino : minos)
+            {
+                bottom[mino.x] = max(bottom[mino.x], mino.y);
+                minCol = min(minCol, mino.x);
+                maxCol = max(maxCol, mino.x);
+            }
+
+            const int length = maxCol - minCol;
+            if (length == 0) continue;
+
+            int window = 0;
+            bool steep = false;
+            for (int x = minCol; x < maxCol; ++x)
+            {
+                const int step = bottom[x] - bottom[x + 1];
+                steep = steep || abs(step) >= CONTOUR_STEP;
+                window = window * CONTOUR_DIGITS + step + CONTOUR_STEP;
+            }
+
+            if (!steep) windows[length][window] |= 1u << type;
+        }
+    }
+
+    return windows;
+}
+
+uint8_t ContourFits(int index)
+{
+    static const vector<uint8_t> table = []
+    {
+        const array<vector<uint8_t>, MAX_WINDOW + 1> windows = BuildWindows();
+        vector<uint8_t> fits(CONTOUR_TABLE_SIZE);
+
+        // Digits of the index, counted up alongside it
+        array<int, CONTOUR_GAPS> digits = {};
+
+        for (int index = 0; index < CONTOUR_TABLE_SIZE; ++index)
+        {
+            uint8_t mask = 1u << I;
+            for (int x = 0; x < CONTOUR_GAPS; ++x)
+            {
+                int window = 0;
+                for (int length = 1; length <= MAX_WINDOW && x + length <= CONTOUR_GAPS; ++length)
+                {
+                    window = window * CONTOUR_DIGITS + digits[x + length - 1];
+                    mask |= windows[length][window];
+                }
+            }
+            fits[index] = mask;
+
+            for (int x = CONTOUR_GAPS - 1; x >= 0 && ++digits[x] == CONTOUR_DIGITS; --x)
+                digits[x] = 0;
+        }
+
+        return fits;
+    }();
+
+    return table[index];
+}
+
+int ContourFit(int index)
+{
+    return popcount(ContourFits(index));
+}
@@ -0,0 +1,34 @@
+#ifndef CONTOUR_HPP
+#define CONTOUR_HPP
+
+#include <array>
+#include <cstdint>
+#include "core/common.hpp"
+
+/* The surface as the height steps between neighbouring columns. No piece
+ * lands cleanly on a step of 2 or more except the I, so every steeper step
+ * reads as 2 and a contour is 9 digits from -2 to 2.
+ */
+constexpr int CONTOUR_STEP = 2;
+constexpr int CONTOUR_DIGITS = 2 * CONTOUR_STEP + 1;
+constexpr int CONTOUR_GAPS = BOARD_WIDTH - 1;
+constexpr int CONTOUR_TABLE_SIZE = []
+{
+    int size = 1;
+    for (int i = 0; i < CONTOUR_GAPS; ++i) size *= CONTOUR_DIGITS;
+    return size;
+}();
+
+// Steps from left to right as one number, the leftmost the most significant digit
+int ContourIndex(const array<int, BOARD_WIDTH>& heights);
+
+/* Bit t set when a piece of type t can land somewhere on the contour
+ * without leaving a hole under it. Derived from the piece shapes on first
+ * use, for all contours at once.
+ */
+uint8_t ContourFits(int index);
+
+// How many piece types the contour takes cleanly, the I always among them
+int ContourFit(int index);
+
+#endif /* CONTOUR_HPP */
@@ -1,126 +1,256 @@
 #include "env.hpp"
+#include "contour.hpp"
+#include "tspin.hpp"
+
+// Rows 0 and 1 are where pieces spawn, the features leave them out
+constexpr uint32_t SCANNED_ROWS = ROWS_MASK & ~3u;
+
+// Rows below the spawn rows as a signature, 20 bits on the standard board
+constexpr int SIGNATURE_BITS = BOARD_HEIGHT - 2;
+
+// What a column signature gives MeasureColumn, 2 bytes so all of them take 2 MB
+struct ColumnSignature
+{
+    uint16_t height : 5;
+    uint16_t holes : 5;
+    uint16_t transitions : 5;
+    uint16_t floorPair : 1;
+
+    // Filled cells, which holds for any signature, not only real columns
+    int Cells() const { return height - holes; }
+};
+
+/* Rows counted from the first filled one down are height rows, the holes
+ * are those left empty, and a transition is a row differing from the one
+ * above.
+ */
+static ColumnSignature ScanSignature(uint32_t signature)
+{
+    ColumnSignature entry = {};
+    const uint32_t cells = signature << 2;
+    if (cells == 0) return entry;
+
+    entry.height = BOARD_HEIGHT - countr_zero(cells);
+    entry.holes = entry.height - popcount(cells);
+    entry.transitions = popcount((cells ^ cells << 1) & ROWS_MASK) - 1;
+    entry.floorPair = (cells >> (BOARD_HEIGHT - 2)) == 3;
+    return entry;
+}
+
+// Built on first use in a few milliseconds, which beats shipping a file for it
+static const ColumnSignature& LookUpColumn(uint32_t col)
+{
+    static const vector<ColumnSignature> table = []
+    {
+        vector<ColumnSignature> entries(size_t(1) << SIGNATURE_BITS);
+        for (uint32_t signature = 0; signature < entries.size(); ++signature)
+            entries[signature] = ScanSignature(signature);
+        return entries;
+    }();
+
+    return table[(col & SCANNED_ROWS) >> 2];
+}
+
+static ColumnHeuristics MeasureColumn(uint32_t col)
+{
+    const ColumnSignature& entry = LookUpColumn(col);
+
+    ColumnHeuristics column;
+    column.filled = entry.height != 0;
+    column.height = entry.height;
+    column.holes = entry.holes;
+    column.transitions = entry.transitions;
+    column.floorPair = entry.floorPair;
+    return column;
+}
+
+// Height the scan of CalcHeuristics carries past the column, the floor pair drops it to 0
+static int LastColHeight(const ColumnHeuristics& column)
+{
+    return (column.filled && !column.floorPair) ? column.height : 0;
+}
+
+/* Open cells of the column right above the given height, counted upwards
+ * while both neighbours are filled or a wall, spawn rows included. Fewer
+ * than 3 is no well.
+ */
+static int MeasureWell(const ColumnMasks& cols, int x, int lastColHeight)
+{
+    const uint32_t left = (x > 0) ? cols[x - 1] : ROWS_MASK;
+    const uint32_t right = (x < BOARD_WIDTH - 1) ? cols[x + 1] : ROWS_MASK;
+    const uint32_t open = ~cols[x] & left & right & ROWS_MASK;
+
+    // The start row to bit 31, the open run above it are the leading ones
+    const int start = BOARD_HEIGHT - lastColHeight - 1;
+    const int depth = countl_one(open << (31 - start));
+    return (depth >= 3) ? depth : 0;
+}
+
+/* Rows above the stack are empty, so all rows below the spawn rows give the
+ * same sum. A row transition is a cell differing from its right neighbour,
+ * counted a column pair at a time off the signature of their difference.
+ */
+static int CountRowTransitions(const ColumnMasks& cols)
+{
+    int transitions = 0;
+    for (int x = 0; x < BOARD_WIDTH - 1; ++x)
+        transitions += LookUpColumn(cols[x] ^ cols[x + 1]).Cells();
+    return transitions;
+}
+
+// Piece types the surface takes without a hole, an empty column counting as height 0
+static int MeasureContour(const array<ColumnHeuristics, BOARD_WIDTH>& columns)
+{
+    array<int, BOARD_WIDTH> heights;
+    for (int x = 0; x < BOARD_WIDTH; ++x)
+        heights[x] = columns[x].height;
+    return ContourFit(ContourIndex(heights));
+}
 
 void TetrisEnv::CalcHeuristics()
 {
     heuristics = BoardHeuristics();
-    int lastColHeight = 0;
+    const ColumnMasks cols = BuildColumnMasks(board);
+    array<ColumnHeuristics, BOARD_WIDTH> columns;
 
-    for (size_t i = 0; i < BOARD_WIDTH; ++i)                                                                                                           
-    {                                                                                                                                                  
-        bool foundFirstFilledCell = false;                                                                                                                       
-        bool prevCell = false;
-        int colHeight = 0;
-        int wellDepth = 0;
+    for (int x = 0; x < BOARD_WIDTH; ++x)
+    {
+        columns[x] = MeasureColumn(cols[x]);
+        columns[x].well = MeasureWell(cols, x, LastColHeight(columns[x]));
+    }
 
-        // Scanning from top to bottom, excluding first 2 rows where pieces spawn
-        for (size_t j = 2; j < BOARD_HEIGHT; ++j)                                                                                                      
-        {
-            bool cellIsFilled = board.GetCell(i, j) != EMPTY; 
-
-            // Encounter a filled cell for the first time
-            if (cellIsFilled && !foundFirstFilledCell)
-            {
-                foundFirstFilledCell = true;                                                                                                                     
-                colHeight = BOARD_HEIGHT - j;
-
-                if (i == 0) lastColHeight = colHeight;
-
-                heuristics.aggrHeight += colHeight;
-                heuristics.maxHeight = max(colHeight, heuristics.maxHeight);
-                heuristics.bumpiness += abs(colHeight - lastColHeight);
-
-                lastColHeight = colHeight;
-            }
-
-            // Encounter a blank cell below a filled cell
-            // 1. A hole
-            // 2. If the cell right above is also filled, a column transition
-            else if (!cellIsFilled && foundFirstFilledCell)                                                                                                                       
-            {
-                heuristics.holeCount++;                                                                                                                               
-                if (prevCell)
-                {
-                    heuristics.colTransition++;
-                    prevCell = cellIsFilled;
-                }
-            }
-
-            // Encounter a filled cell, not the first filled one in the column
-            // and the cell above is blank, a column transition
-            else if (cellIsFilled && foundFirstFilledCell && !prevCell)
-            {
-                heuristics.colTransition++;
-                prevCell = cellIsFilled;
-            }
-
-            // Reached the bottom while no flag is set, a whole empty column
-            else if (j == BOARD_HEIGHT - 1)
-            {
-                heuristics.bumpiness += lastColHeight;
-                lastColHeight = 0;
-            }
-
-            prevCell = cellIsFilled;
-        }
+    SumColumns(columns);
+    heuristics.rowTransition = CountRowTransitions(cols);
+
+    // Slots a T could spin into right now, worth as many lines as it would clear
+    if (weights.tSpinSetup != 0)
+        heuristics.tSpinSlotLines = CountTSpinSlotLines(BuildRowMasks(board));
+
+    if (weights.contour != 0)
+        heuristics.contourFit = MeasureContour(columns);
+}
+
+void TetrisEnv::CacheHeuristics()
+{
+    cache.cols = BuildColumnMasks(board);
+
+    for (int x = 0; x < BOARD_WIDTH; ++x)
+    {
+        cache.columns[x] = MeasureColumn(cache.cols[x]);
+        cache.columns[x].well = MeasureWell(cache.cols, x, LastColHeight(cache.columns[x]));
+    }
+}
+
+void TetrisEnv::CalcHeuristics(BlockType type, const Placement& placement)
+{
+    heuristics = BoardHeuristics();
+    ColumnMasks cols = cache.cols;
+    array<ColumnHeuristics, BOARD_WIDTH> columns = cache.columns;
+    uint32_t touched = 0;
+
+    for (const Coord& mino : blockData[type][placement.rotation])
+    {
+        cols[placement.posX + mino.x] |= 1u << (placement.posY + mino.y);
+        touched |= 1u << (placement.posX + mino.x);
+    }
+
+    for (int x = 0; x < BOARD_WIDTH; ++x)
+        if (touched >> x & 1)
+            columns[x] = MeasureColumn(cols[x]);
+
+    // A well looks at both its neighbours
+    const uint32_t wellCols = touched | touched << 1 | touched >> 1;
+    for (int x = 0; x < BOARD_WIDTH; ++x)
+        if (wellCols >> x & 1)
+            columns[x].well = MeasureWell(cols, x, LastColHeight(columns[x]));
 
-        // Check for a well
-        Block wellTester;
-        bool isWell = false;
-        int wellRows = BOARD_HEIGHT - lastColHeight - wellDepth - 1;
+    SumColumns(columns);
+    heuristics.rowTransition = CountRowTransitions(cols);
 
-        while (board.CheckFit(int(i), wellRows, wellTester)
-            && !board.CheckFit(int(i) - 1, wellRows, wellTester)
-            && !board.CheckFit(int(i) + 1, wellRows, wellTester))
+    if (weights.tSpinSetup != 0)
+        heuristics.tSpinSlotLines = CountTSpinSlotLines(BuildRowMasks(board));
+
+    if (weights.contour != 0)
+        heuristics.contourFit = MeasureContour(columns);
+}
+
+// The order dependent part, left to right over the columns
+void TetrisEnv::SumColumns(const array<ColumnHeuristics, BOARD_WIDTH>& columns)
+{
+    int lastColHeight = 0;
+
+    for (int x = 0; x < BOARD_WIDTH; ++x)
+    {
+        const ColumnHeuristics& column = columns[x];
+        heuristics.holeCount += column.holes;
+        heuristics.colTransition += column.transitions;
+
+        if (column.filled)
         {
-            if (++wellDepth >= 3) isWell = true;
-            wellRows = BOARD_HEIGHT - lastColHeight - wellDepth - 1;
+            if (x == 0) lastColHeight = column.height;
+
+            heuristics.aggrHeight += column.height;
+            heuristics.maxHeight = max(column.height, heuristics.maxHeight);
+            heuristics.bumpiness += abs(column.height - lastColHeight);
+            lastColHeight = column.height;
         }
 
-        if (isWell)
+        if (!column.filled || column.floorPair)
         {
-            heuristics.wellDepth = max(wellDepth, heuristics.wellDepth);
-            heuristics.additionalWell++;
+            heuristics.bumpiness += lastColHeight;
+            lastColHeight = 0;
         }
-    }                                                                                                                                                  
 
-    // Row transition
-    for (size_t i = BOARD_HEIGHT - heuristics.maxHeight; i < BOARD_HEIGHT; ++i)
-    {
-        bool prevCell = board.GetCell(0, i) != EMPTY; 
-        for (size_t j = 1; j < BOARD_WIDTH; ++j)
+        if (column.well > 0)
         {
-            bool thisCell = board.GetCell(j, i) != EMPTY;
-            if (prevCell != thisCell)
-            {
-                heuristics.rowTransition++;
-                prevCell = thisCell;
-            }
+            heuristics.wellDepth = max(column.well, heuristics.wellDepth);
+            heuristics.additionalWell++;
         }
     }
 }
 
-int TetrisEnv::CalcScore()
+int TetrisEnv::CalcScore(SpinType spin)
 {
     int clearedLine = board.CheckFullRow();
     int lastScore = stats.score;
 
-    if (clearedLine == 0)
+    // Scored the same way as TetrisUI::LockBlock, all-spins earn no bonus there
+    bool tSpin = (spin == T_SPIN || spin == T_SPIN_MINI);
+    bool isNormalTspin = (spin == T_SPIN);
+
+    if (clearedLine == 0 && !tSpin)
     {
         stats.comboCount = -1;
         return 0;
     }
-
-    stats.comboCount++;
-    stats.clearedLineCount += clearedLine;
-    stats.score += stats.comboCount * 50 * stats.level;
+    else if (clearedLine)
+    {
+        stats.comboCount++;
+        stats.clearedLineCount += clearedLine;
+        stats.score += stats.comboCount * 50 * stats.level;
+    }
 
     int baseScore = 0;
-    switch (clearedLine)
+    if (tSpin)
     {
-        case 1: baseScore = 100; stats.b2bChain = -1; break;
-        case 2: baseScore = 300; stats.b2bChain = -1; break;
-        case 3: baseScore = 500; stats.b2bChain = -1; break;
-        case 4: baseScore = 800; stats.tetrisCount++; stats.b2bChain++; break;
+        stats.tSpinCount++;
+        switch (clearedLine)
+        {
+            case 0: baseScore = 100 + 300 * isNormalTspin; break;
+            case 1: baseScore = 200 + 600 * isNormalTspin; stats.b2bChain++; break;
+            case 2: baseScore = 400 + 800 * isNormalTspin; stats.b2bChain++; break;
+            case 3: baseScore = 1600; stats.b2bChain++; break;
+        }
+    }
+    else
+    {
+        switch (clearedLine)
+        {
+            case 1: baseScore = 100; stats.b2bChain = -1; break;
+            case 2: baseScore = 300; stats.b2bChain = -1; break;
+            case 3: baseScore = 500; stats.b2bChain = -1; break;
+            case 4: baseScore = 800; stats.tetrisCount++; stats.b2bChain++; break;
+        }
     }
 
     if (stats.b2bChain > 0)
@@ -142,26 +272,42 @@ int TetrisEnv::CalcScore()
     return stats.score - lastScore;
 }
 
-double TetrisEnv::CalcReward()
+double TetrisEnv::CalcReward(SpinType spin)
 {
     CalcHeuristics();
-    return weights.holeCount * heuristics.holeCount
-    + weights.aggrHeight * heuristics.aggrHeight
-    + weights.maxHeight * heuristics.maxHeight
-    + weights.bumpiness * heuristics.bumpiness
-    + weights.rowTransition * heuristics.rowTransition
-    + weights.colTransition * heuristics.colTransition
-    + weights.wellDepth * heuristics.wellDepth
-    + weights.multiWell * heuristics.additionalWell
-    + weights.gameScore * CalcScore();
+    return WeighHeuristics(heuristics, CalcScore(spin));
+}
+
+double TetrisEnv::CalcReward(BlockType type, const Placement& placement)
+{
+    CalcHeuristics(type, placement);
+    return WeighHeuristics(heuristics, CalcScore(placement.spin));
+}
+
+double TetrisEnv::WeighHeuristics(const BoardHeuristics& features, int score) const
+{
+    // The contour stands in for the surface terms, without it the sum is the trained one
+    const bool contour = weights.contour != 0;
+
+    return weights.holeCount * features.holeCount
+    + weights.aggrHeight * features.aggrHeight
+    + weights.maxHeight * features.maxHeight
+    + (contour ? 0 : weights.bumpiness) * features.bumpiness
+    + weights.rowTransition * features.rowTransition
+    + weights.colTransition * features.colTransition
+    + (contour ? 0 : weights.wellDepth) * features.wellDepth
+    + (contour ? 0 : weights.multiWell) * features.additionalWell
+    + weights.tSpinSetup * features.tSpinSlotLines
+    + weights.contour * features.contourFit
+    + weights.gameScore * score;
 }
 
-void TetrisEnv::MakeMove(RotateState s, int posX)
+void TetrisEnv::MakeMove(const Placement& placement)
 {
-    currentBlock.Rotate(s);
-    currentBlock.Move(posX, 0);
-    currentBlock.Move(0, GetHardDropPos());
+    currentBlock.ResetPosition();
+    currentBlock.Rotate(placement.rotation);
+    currentBlock.Move(placement.posX, placement.posY);
 
     UpdateBoard();
-    CalcScore();
+    CalcScore(placement.spin);
 }
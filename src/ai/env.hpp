@@ -16,65 +16,14 @@ constexpr array<int, BLOCK_TYPES> uniqueRotations = {{
     2  // Z piece: 8 horizontal pos, 9 vertical pos, 2 rotations
 }};
 
-constexpr vector<int> createVecRange(int start, int end)
-{
-    vector<int> vec;
-    for (int i = start; i <= end; ++i) vec.push_back(i);
-    return vec;
-}
 
-constexpr vector<int> ParseMove(const BlockType type, const RotateState state)
+// Final resting position of a piece, as produced by the move generators
+struct Placement
 {
-    switch (type)
-    {
-        case I:
-            switch (state)
-            {
-                case INITIAL: return createVecRange(0, 6); break;
-                case LEFT: return createVecRange(-1, 8); break;
-                case DOWN: return createVecRange(0, 6); break;
-                case RIGHT: return createVecRange(-2, 7); break;
-            }
-            break;
-
-        case J:
-        case L:
-        case T:
-            switch (state)
-            {
-                case INITIAL: return createVecRange(0, 7); break;
-                case LEFT: return createVecRange(0, 8); break;
-                case DOWN: return createVecRange(0, 7); break;
-                case RIGHT: return createVecRange(0, 8); break;
-            }
-            break;
-
-        case O:
-            switch (state)
-            {
-                case INITIAL: return createVecRange(0, 8); break;
-                case LEFT: return createVecRange(0, 8); break;
-                case DOWN: return createVecRange(0, 8); break;
-                case RIGHT: return createVecRange(0, 8); break;
-            }
-            break;
-
-        case S:
-        case Z:
-            switch (state)
-            {
-                case INITIAL: return createVecRange(0, 8); break;
-                case LEFT: return createVecRange(0, 8); break;
-                case DOWN: return createVecRange(0, 8); break;
-                case RIGHT: return createVecRange(0, 8); break;
-            }
-            break;
-
-        case EMPTY: break;
-    }
-    return {};
-}
-
+    RotateState rotation;
+    int posX, posY;
+    SpinType spin = NO_SPIN;
+};
 
 struct BoardHeuristics
 {
@@ -86,6 +35,29 @@ struct BoardHeuristics
     int colTransition = 0;
     int wellDepth = 0;
     int additionalWell = -1;
+    int tSpinSlotLines = 0;     // only counted with a tSpinSetup weight
+    int contourFit = 0;         // only counted with a contour weight
+};
+
+// One column's share of BoardHeuristics, as CalcHeuristics counts it
+struct ColumnHeuristics
+{
+    bool filled = false;        // anything below the spawn rows
+    bool floorPair = false;     // bottom two cells filled, which CalcHeuristics counts as a drop to 0
+    int height = 0;
+    int holes = 0;
+    int transitions = 0;
+    int well = 0;               // open cells above, between two filled neighbours
+};
+
+/* The columns of one board with their share of the features. A piece
+ * locked into that board changes only the columns it covers, and the wells
+ * beside them, so only those are measured again.
+ */
+struct HeuristicsCache
+{
+    array<uint32_t, BOARD_WIDTH> cols;  // as BuildColumnMasks builds them
+    array<ColumnHeuristics, BOARD_WIDTH> columns;
 };
 
 struct HeuristicsWeights
@@ -100,6 +72,13 @@ struct HeuristicsWeights
     double wellDepth = 1;
     double gameScore = 1;
 
+    // Not trained by the GA (asArray leaves it out), set through TetrisHeurAI::SetTSpinSetups
+    double tSpinSetup = 0;
+
+    // Also untrained, set through TetrisHeurAI::SetContour. Non-zero, it takes
+    // over from bumpiness, wellDepth and multiWell
+    double contour = 0;
+
     array<double*, 9> asArray()
     {
         return {{
@@ -125,11 +104,25 @@ protected:
     BoardHeuristics heuristics;
     HeuristicsWeights weights;
 
+    HeuristicsCache cache;
+
     void CalcHeuristics();
-    int CalcScore();
-    double CalcReward();
+    int CalcScore(SpinType spin=NO_SPIN);
+    double CalcReward(SpinType spin=NO_SPIN);
+
+    // For every placement on the board as it is now, before any is locked in
+    void CacheHeuristics();
+    // Same as CalcHeuristics and CalcReward on the cached board with the piece locked in
+    void CalcHeuristics(BlockType type, const Placement& placement);
+    double CalcReward(BlockType type, const Placement& placement);
+
+    // The reward of CalcReward, for features and a score measured elsewhere
+    double WeighHeuristics(const BoardHeuristics& features, int score) const;
+
+    void MakeMove(const Placement& placement);
 
-    void MakeMove(RotateState s, int posX);
+private:
+    void SumColumns(const array<ColumnHeuristics, BOARD_WIDTH>& columns);
 };
 
 #endif /* ENV_HPP */
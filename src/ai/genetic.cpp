@@ -83,7 +83,13 @@ void Individual::CalculateFitness(TetrisHeurAI& game, int index, bool render)
             cout << "Line cleared: " << game.stats.clearedLineCount << endl;
             cout << "Blocks count: " << game.stats.droppedBlockCount << " (PPS: "
                 << format("{:.2f}/s", game.stats.droppedBlockCount / game.stats.timeElapsed.count())
-                << ")" << endl << endl;
+                << ")" << endl;
+
+            const SearchStats& search = game.GetSearchTotals();
+            cout << "Search: " << format("{:.0f} nodes/s, depth {:.1f}, branching {:.1f}, cutoffs {:.0f}%, table hits {:.0f}%",
+                search.NodesPerSecond(), search.AverageDepth(), search.BranchingFactor(), search.CutoffRate() * 100,
+                search.HitRate() * 100) << endl << endl;
+            game.ResetSearchStats();
             game.NewGame();
         }
     }
@@ -4,8 +4,25 @@ TetrisHeurAI::TetrisHeurAI()
     : renderer(stats, {{ SCORE, TIME, LINESPEED, BLOCKCOUNT, CUSTOM }})
     , pps(0.0)
     , timer(0)
+    , beamWidth(0)
+    , beamDepth(0)
+    , chancePlies(0)
+    , chanceBranch(0)
+    , rolloutCount(0)
+    , rolloutPlies(0)
+    , pruneMinWidth(0)
+    , pruneMaxWidth(0)
+    , perfectClear(false)
+    , tableSize(TT_DEFAULT_MB)
+    , pondering(true)
 {};
 
+// Subclasses overriding FindBestMove stop the ponder first, too
+TetrisHeurAI::~TetrisHeurAI()
+{
+    StopPondering();
+}
+
 void TetrisHeurAI::Update()
 {
     if (gameOver) return;
@@ -22,21 +39,43 @@ void TetrisHeurAI::Update()
         else timer++;
     }
 
-    GameStats origStats = stats;
     bool useHold = false;
-    int move = -1;
-    RotateState rotation = INITIAL;
+    Placement placement = { INITIAL, 0, 0 };
+    bool foundMove;
 
     currentBlock.ResetPosition();
-    FindBestMove(useHold, move, rotation);
 
-    stats = origStats;
+    // Searched in the background since the last move, from this very position
+    const SearchResult result = ponder.valid() ? ponder.get() : Search(MakeRoot(), MakeQueue());
+    foundMove = result.found;
+    useHold = result.useHold;
+    placement = result.placement;
+
+    lastSearchStats = result.stats;
+    searchTotals += result.stats;
+
+    // Nothing fits anymore, the piece would spawn inside the stack
+    if (!foundMove)
+    {
+        gameOver = true;
+        return;
+    }
 
     if (useHold) HoldBlock();
 
-    currentBlock.ResetPosition();
-    MakeMove(rotation, move);
+    playedType = currentBlock.GetType();
+    playedHold = useHold;
+    playedPlacement = placement;
+
+    MakeMove(placement);
     stats.droppedBlockCount++;
+
+    // The next position is known exactly, search it while the pps timer runs
+    if (pondering && pps != 0 && !gameOver)
+        ponder = async(launch::async, [this, root = MakeRoot(), queue = MakeQueue()]
+        {
+            return Search(root, queue);
+        });
 }
 
 void TetrisHeurAI::Draw(const string& customTitle, const string& customData, const string& customSubData)
@@ -57,123 +96,492 @@ void TetrisHeurAI::Draw(const string& customTitle, const string& customData, con
 
 void TetrisHeurAI::UpdateHeuristics(HeuristicsWeights newWeights)
 {
+    StopPondering();
+    const double tSpinSetup = weights.tSpinSetup;
+    const double contour = weights.contour;
     weights = newWeights;
+    weights.tSpinSetup = tSpinSetup;
+    weights.contour = contour;
+    table.Clear();
 }
 
 void TetrisHeurAI::SetPPS(float pps)
 {
+    StopPondering();
     this->pps = pps;
 }
 
+void TetrisHeurAI::SetSpinSearch(bool enabled)
+{
+    StopPondering();
+    movement.spins = enabled;
+    table.Clear();
+}
+
+void TetrisHeurAI::SetGravity(float gravity)
+{
+    StopPondering();
+    movement.gravity = min(gravity, MAX_GRAVITY);
+    movement.lockMoves = LOCK_DOWN_MOVES;
+    table.Clear();
+}
+
+// A width of 0 goes back to the two piece search, a depth of 0 covers the whole preview
+void TetrisHeurAI::SetBeamSearch(int width, int depth)
+{
+    StopPondering();
+    beamWidth = max(width, 0);
+    beamDepth = max(depth, 0);
+}
+
+// Searched from the leaves of the beam search, so it needs a beam width set
+void TetrisHeurAI::SetExpectimax(int plies, int branch)
+{
+    StopPondering();
+    chancePlies = max(plies, 0);
+    chanceBranch = max(branch, 1);
+}
+
+/* Scores the beam leaves by playing each a few more pieces, what the board
+ * alone does not show. Needs a beam width set, like the expectimax.
+ */
+void TetrisHeurAI::SetRollouts(int count, int plies)
+{
+    StopPondering();
+    rolloutCount = max(count, 0);
+    rolloutPlies = max(plies, 0);
+}
+
+// Allocated on the first deep search otherwise, 0 megabytes turns it off
+void TetrisHeurAI::SetTranspositionTable(size_t megabytes, bool hugePages)
+{
+    StopPondering();
+    table.Resize(megabytes, hugePages);
+    tableSize = megabytes;
+}
+
+// Threads beyond the first search the root candidates in parallel
+void TetrisHeurAI::SetThreads(int count)
+{
+    StopPondering();
+    workers.clear();
+    threads.reset();
+    if (count <= 1) return;
+
+    threads = make_unique<ThreadPool>(count);
+    for (int i = 0; i < count; ++i)
+        workers.push_back(make_unique<SearchWorker>());
+}
+
+void TetrisHeurAI::SetPondering(bool enabled)
+{
+    StopPondering();
+    pondering = enabled;
+}
+
+// Full second piece search for only the best first placements, 0 keeps them all
+void TetrisHeurAI::SetPruning(int minWidth, int maxWidth)
+{
+    StopPondering();
+    pruneMinWidth = max(minWidth, 1);
+    pruneMaxWidth = max(maxWidth, 0);
+    if (pruneMaxWidth > 0) pruneMaxWidth = max(pruneMaxWidth, pruneMinWidth);
+}
+
+// Plays a perfect clear whenever the known pieces make one on a low enough stack
+void TetrisHeurAI::SetPerfectClear(bool enabled)
+{
+    StopPondering();
+    perfectClear = enabled;
+}
+
+/* Rewards each line a ready T-spin slot would clear, on top of the trained
+ * weights, which it outlives. Slots are only filled with spins searched.
+ */
+void TetrisHeurAI::SetTSpinSetups(double weight)
+{
+    StopPondering();
+    weights.tSpinSetup = weight;
+    table.Clear();
+}
+
+/* Rewards each piece type the surface takes without a hole, from the
+ * contour table, in place of the bumpiness and well terms. 0 goes back to
+ * those.
+ */
+void TetrisHeurAI::SetContour(double weight)
+{
+    StopPondering();
+    weights.contour = weight;
+    table.Clear();
+}
+
+// Book moves replace the search wherever the book has the position, an empty path closes it
+bool TetrisHeurAI::LoadOpeningBook(const string& path)
+{
+    StopPondering();
+    if (path.empty())
+    {
+        book.Close();
+        return false;
+    }
+    return book.Load(path);
+}
+
 void TetrisHeurAI::NewGame()
 {
+    StopPondering();
     TetrisCore::NewGame();
     timer = 0;
 }
 
-void TetrisHeurAI::FindBestMove(bool& useHold, int& bestMove, RotateState& bestRotation)
-{
-    double bestRewardNoHold = -numeric_limits<float>::infinity();
-    double bestRewardHold = -numeric_limits<float>::infinity();
-    int bestMoveNoHold = -1;
-    int bestMoveHold = -1;
-    RotateState bestRotationNoHold = INITIAL;
-    RotateState bestRotationHold = INITIAL;
-
-    // Case 1: No held piece.
-    // -> Current piece + next piece < next piece + 2nd next piece ? hold : normal
-    //
-    // Case 2: Held piece exists.
-    // -> The held piece + next piece > current piece + next piece ? hold : normal
-
-    Block currentBlock = this->currentBlock;
-    Block nextBlock(currentBag.at(0));
-    Block secondNextBlock(currentBag.at(1));
-    Block holdBlock = this->holdBlock;
-    
-    TryMoves(currentBlock, nextBlock, bestRewardNoHold, bestMoveNoHold, bestRotationNoHold);
-    if (!holdBlock && nextBlock != secondNextBlock)
-        TryMoves(nextBlock, secondNextBlock, bestRewardHold, bestMoveHold, bestRotationHold);
-    else if (holdBlock && currentBlock != holdBlock)
-        TryMoves(holdBlock, nextBlock, bestRewardHold, bestMoveHold, bestRotationHold);
-    
-
-    if (bestRewardNoHold > bestRewardHold)
-    {
-        useHold = false;
-        bestMove = bestMoveNoHold;
-        bestRotation = bestRotationNoHold;
+const SearchStats& TetrisHeurAI::GetLastSearchStats() const
+{
+    return lastSearchStats;
+}
+
+const SearchStats& TetrisHeurAI::GetSearchTotals() const
+{
+    return searchTotals;
+}
+
+void TetrisHeurAI::ResetSearchStats()
+{
+    StopPondering();
+    lastSearchStats = SearchStats();
+    searchTotals = SearchStats();
+}
+
+// One decision with what it cost, pondered or not
+SearchResult TetrisHeurAI::Search(const SearchNode& root, const vector<BlockType>& queue)
+{
+    worker.ResetStats();
+    for (auto& threadWorker : workers)
+        threadWorker->ResetStats();
+
+    const auto start = chrono::steady_clock::now();
+
+    SearchResult result;
+    result.found = FindBestMove(root, queue, result.useHold, result.placement);
+
+    result.stats = CollectStats();
+    result.stats.decisions = 1;
+    result.stats.time = chrono::steady_clock::now() - start;
+    return result;
+}
+
+// Summed over the main worker and the thread workers, which all search the same decision to the deepest of them
+SearchStats TetrisHeurAI::CollectStats()
+{
+    SearchStats total = worker.Stats();
+    for (auto& threadWorker : workers)
+    {
+        const int depth = max(total.depth, threadWorker->Stats().depth);
+        total += threadWorker->Stats();
+        total.depth = depth;
+    }
+    return total;
+}
+
+/* Searches only read the root and queue handed to them, never the game
+ * itself, so they can run while the game is drawn.
+ */
+bool TetrisHeurAI::FindBestMove(const SearchNode& root, const vector<BlockType>& queue, bool& useHold,
+                                Placement& bestPlacement)
+{
+    if (FindPerfectClear(root, queue, useHold, bestPlacement)) return true;
+    if (FindBookMove(root, queue, useHold, bestPlacement)) return true;
+    if (beamWidth > 0) return FindBeamMove(root, queue, useHold, bestPlacement);
+
+    // Holding is one more move at the root, and the second piece may hold too
+    candidates.clear();
+    worker.Configure(weights, movement);
+
+    auto collect = [&](const SearchNode& child) { candidates.push_back({ child }); };
+    worker.Expand(root, queue, collect);
+
+    MarkDuplicates(queue);
+    if (pruneMaxWidth > 0) PruneCandidates(root);
+
+    for (const RootCandidate& candidate : candidates)
+        if (candidate.pruned || candidate.duplicateOf >= 0) worker.Stats().cutoffs++;
+
+    RunCandidates([&](SearchWorker& searcher, RootCandidate& candidate)
+    {
+        if (candidate.pruned || candidate.duplicateOf >= 0)
+            candidate.reward = -numeric_limits<double>::infinity();
+        else candidate.reward = searcher.BestChildReward(candidate.node, queue);
+    });
+
+    // Reduced in the order the moves were generated, so thread timing never changes the pick
+    const RootCandidate* best = nullptr;
+    for (const RootCandidate& candidate : candidates)
+        if (!best || candidate.reward > best->reward) best = &candidate;
+
+    if (!best || best->reward == -numeric_limits<double>::infinity()) return false;
+
+    useHold = best->node.firstHold;
+    bestPlacement = best->node.firstPlacement;
+    return true;
+}
+
+/* Holding or not can end in the same position, for instance when the held
+ * piece comes back at once. Only the first one is searched further, the
+ * others would tie with it and lose the tie anyway.
+ */
+void TetrisHeurAI::MarkDuplicates(const vector<BlockType>& queue)
+{
+    candidateKeys.clear();
+
+    for (size_t i = 0; i < candidates.size(); ++i)
+    {
+        const uint64_t key = worker.NodeKey(candidates[i].node, queue, 0);
+        const auto [it, inserted] = candidateKeys.try_emplace(key, int(i));
+        if (!inserted) candidates[i].duplicateOf = it->second;
     }
-    else
+}
+
+/* First stage: every first placement already has its own reward from the
+ * expansion, only the best few get the full second piece. The count grows
+ * from pruneMinWidth on an empty board to pruneMaxWidth as the stack
+ * reaches the top, where a cheap first impression is the least reliable.
+ */
+void TetrisHeurAI::PruneCandidates(const SearchNode& root)
+{
+    int stackHeight = 0;
+    for (uint32_t col : BuildColumnMasks(root.board))
+        stackHeight = max(stackHeight, BOARD_HEIGHT - countr_zero(col));
+
+    const size_t width = pruneMinWidth + (pruneMaxWidth - pruneMinWidth) * stackHeight / BOARD_HEIGHT;
+
+    vector<int> order;
+    for (size_t i = 0; i < candidates.size(); ++i)
+        if (candidates[i].duplicateOf < 0) order.push_back(int(i));
+
+    if (width >= order.size()) return;
+
+    // Ranked by first reward, ties by generation order, so the cut is deterministic
+    nth_element(order.begin(), order.begin() + width, order.end(), [&](int a, int b)
+    {
+        if (candidates[a].node.reward != candidates[b].node.reward)
+            return candidates[a].node.reward > candidates[b].node.reward;
+        return a < b;
+    });
+
+    for (size_t i = width; i < order.size(); ++i)
+        candidates[order[i]].pruned = true;
+}
+
+void TetrisHeurAI::RunCandidates(const function<void(SearchWorker&, RootCandidate&)>& score)
+{
+    if (!threads)
     {
-        useHold = true;
-        bestMove = bestMoveHold;
-        bestRotation = bestRotationHold;
+        worker.Configure(weights, movement);
+        for (RootCandidate& candidate : candidates)
+            score(worker, candidate);
+        return;
     }
+
+    for (auto& threadWorker : workers)
+        threadWorker->Configure(weights, movement);
+
+    threads->Run(int(candidates.size()), [&](int task, int thread)
+    {
+        score(*workers[thread], candidates[task]);
+    });
+}
+
+// The game as it stands, as the start of a search
+SearchNode TetrisHeurAI::MakeRoot()
+{
+    SearchNode root;
+    root.board = board;
+    root.stats = stats;
+    root.current = currentBlock.GetType();
+    root.hold = holdBlock.GetType();
+    return root;
+}
+
+vector<BlockType> TetrisHeurAI::MakeQueue()
+{
+    return vector<BlockType>(currentBag.begin(), currentBag.end());
 }
 
-double TetrisHeurAI::SimulateMove(Block& block, RotateState s, int posX)
+// Waits the background search out, its move is no longer wanted
+void TetrisHeurAI::StopPondering()
 {
-    block.Rotate(s);
-    block.Move(posX, 0);
+    if (ponder.valid()) ponder.get();
+}
+
+/* The heuristic search practically never plans a full clear, the solver
+ * does in a few milliseconds when there is one. Its line is scored by
+ * TetrisEnv like any other, full clear bonus included, and replaces the
+ * regular search.
+ */
+bool TetrisHeurAI::FindPerfectClear(const SearchNode& root, const vector<BlockType>& queue, bool& useHold,
+                                    Placement& bestPlacement)
+{
+    if (!perfectClear) return false;
+
+    PerfectClear solution;
+    pcSolver.Configure(movement);
+    if (!pcSolver.Solve(root, queue, solution)) return false;
+
+    useHold = solution.steps[0].useHold;
+    bestPlacement = solution.steps[0].placement;
+    return true;
+}
+
+/* A book searched with other weights plays another game and is skipped.
+ * It is built with hard drops only, so its moves are checked against the
+ * placements the movement model reaches, and played as the generator
+ * reports them, spin included.
+ */
+bool TetrisHeurAI::FindBookMove(const SearchNode& root, const vector<BlockType>& queue, bool& useHold,
+                                Placement& bestPlacement)
+{
+    if (!book.IsOpen() || book.WeightsHash() != BookWeightsHash(weights)) return false;
+
+    bool bookHold;
+    Placement placement;
+    if (!book.Probe(root, queue, bookHold, placement)) return false;
 
-    int hardDrop = 0;
-    while (board.CheckFit(0, hardDrop++, block));
+    BlockType type = root.current;
+    if (bookHold && root.hold != EMPTY) type = root.hold;
+    else if (bookHold) type = (root.next < int(queue.size())) ? queue[root.next] : EMPTY;
+    if (type == EMPTY) return false;
 
-    if (hardDrop <= 1)
-        return -1e5;
+    // The generator reports one rotation per shape, which need not be the book's
+    auto cells = [type](const Placement& p)
+    {
+        array<Coord, TETROMINO_SIZE> minos = blockData[type][p.rotation];
+        for (Coord& mino : minos) mino = { p.posX + mino.x, p.posY + mino.y };
+        sort(minos.begin(), minos.end(), [](const Coord& a, const Coord& b) { return a.x != b.x ? a.x < b.x : a.y < b.y; });
+        return minos;
+    };
 
-    block.Move(0, hardDrop - 2);
-    board.LockBlock(block);
+    PlacementList reachable;
+    GenerateReachable(BuildColumnMasks(root.board), type, reachable, movement);
 
-    return CalcReward();
+    const auto bookCells = cells(placement);
+    for (int i = 0; i < reachable.count; ++i)
+    {
+        const auto reachableCells = cells(reachable.items[i]);
+        if (!equal(bookCells.begin(), bookCells.end(), reachableCells.begin(),
+                   [](const Coord& a, const Coord& b) { return a.x == b.x && a.y == b.y; }))
+            continue;
+
+        useHold = bookHold;
+        bestPlacement = reachable.items[i];
+        return true;
+    }
+
+    return false;
 }
 
-void TetrisHeurAI::TryMoves(Block& firstBlock, Block& secondBlock, double& bestReward, int& bestMove, RotateState& bestRotation)
+/* At a target pps the search gets most of the time until the next piece.
+ * It starts at the configured width and doubles it while time remains,
+ * keeping the last search that finished.
+ */
+bool TetrisHeurAI::FindBeamMove(const SearchNode& root, const vector<BlockType>& queue, bool& useHold,
+                                Placement& bestPlacement)
 {
-    BlockType firstType = firstBlock.GetType();
-    BlockType secondType = secondBlock.GetType();
+    const int previewDepth = int(queue.size()) + 1;
+
+    BeamSettings settings;
+    settings.depth = (beamDepth == 0) ? previewDepth : min(beamDepth, previewDepth);
+    settings.chancePlies = chancePlies;
+    settings.chanceBranch = chanceBranch;
+    settings.rollouts = rolloutCount;
+    settings.rolloutPlies = rolloutPlies;
+    settings.deadline = SearchDeadline();
 
-    double reward = -numeric_limits<float>::infinity();
-    int move = -1;
-    RotateState rotation = INITIAL;
+    if (tableSize != 0 && table.Size() == 0) table.Resize(tableSize);
 
-    for (int i = 0; i < uniqueRotations.at(firstType); ++i)
+    SearchResult best;
+
+    for (int width = beamWidth; ; width *= 2)
     {
-        const RotateState tryRotation = (RotateState)i;
-        Board orig1 = board;
+        SearchResult found;
+        settings.width = width;
+        const bool finished = RunBeamSearch(root, queue, settings, found);
 
-        for (const auto& tryPosX : ParseMove(firstType, tryRotation))
-        {
-            double firstReward = SimulateMove(firstBlock, tryRotation, tryPosX);
-
-            for (int j = 0; j < uniqueRotations.at(secondType); ++j)
-            {
-                const RotateState tryRotation2 = (RotateState)i;
-                Board orig2 = board;
-
-                for (const auto& tryPosX2 : ParseMove(secondType, tryRotation2))
-                {
-                    double secondReward = SimulateMove(secondBlock, tryRotation2, tryPosX2);
-
-                    if (firstReward + secondReward > reward)
-                    {
-                        reward = firstReward + secondReward;
-                        move = tryPosX;
-                        rotation = tryRotation;
-                    }
-
-                    board = orig2;
-                    secondBlock.ResetPosition();
-                }
-            }
-
-            board = orig1;
-            firstBlock.ResetPosition();
-        }
+        // An interrupted search only stands in when it got deeper than what we have
+        if (found.found && (finished || found.depth > best.depth))
+            best = found;
+
+        if (!finished || pps == 0 || width >= MAX_BEAM_WIDTH) break;
+    }
+
+    useHold = best.useHold;
+    bestPlacement = best.placement;
+    return best.found;
+}
+
+/* With threads every worker runs the beam search on the same position,
+ * each a slightly different variant, all sharing one table (lazy SMP).
+ * Expectimax and rollout values are shared, so threads that finish cheap
+ * lines early spread out instead of waiting on a fixed share of the root.
+ * Each beam only skips the transpositions it found itself, so no thread
+ * drops nodes from another's beam; at worst an entry the others evicted
+ * lets a duplicate through.
+ */
+bool TetrisHeurAI::RunBeamSearch(const SearchNode& root, const vector<BlockType>& queue,
+                                 const BeamSettings& settings, SearchResult& best)
+{
+    table.NewSearch();
+    TranspositionTable* sharedTable = table.Size() ? &table : nullptr;
+
+    if (!threads)
+    {
+        worker.Configure(weights, movement);
+        worker.SetTable(sharedTable);
+        return worker.BeamSearch(root, queue, settings, best);
+    }
+
+    results.assign(workers.size(), SearchResult());
+    finished.assign(workers.size(), false);
+    for (auto& threadWorker : workers)
+    {
+        threadWorker->Configure(weights, movement);
+        threadWorker->SetTable(sharedTable);
     }
 
-    bestReward = reward;
-    bestMove = move;
-    bestRotation = rotation;
+    threads->Run(int(workers.size()), [&](int task, int thread)
+    {
+        BeamSettings variant = settings;
+        variant.variant = task;
+        variant.variants = int(workers.size());
+        finished[task] = workers[thread]->BeamSearch(root, queue, variant, results[task]);
+    });
+
+    /* Rewards are sums over the plies and stages a variant got through, so
+     * they only compare between equals. A variant cut off early keeps the
+     * higher per-ply rewards of a shallow line, the deeper result wins
+     * instead. Ties go to the lower variant, the plain beam first.
+     */
+    auto better = [](const SearchResult& a, const SearchResult& b)
+    {
+        if (a.depth != b.depth) return a.depth > b.depth;
+        if (a.stage != b.stage) return a.stage > b.stage;
+        return a.reward > b.reward;
+    };
+
+    int chosen = -1;
+    for (int i = 0; i < int(results.size()); ++i)
+        if (results[i].found && (chosen < 0 || better(results[i], results[chosen]))) chosen = i;
+
+    if (chosen < 0) return finished[0];
+
+    best = results[chosen];
+    return finished[chosen];
+}
+
+// No deadline without a target pps, the search then always runs to the end
+chrono::steady_clock::time_point TetrisHeurAI::SearchDeadline()
+{
+    if (pps == 0) return chrono::steady_clock::time_point::max();
+
+    const chrono::duration<double> share(SEARCH_TIME_SHARE / pps);
+    return chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(share);
 }
@@ -3,30 +3,121 @@
 
 #include <chrono>
 #include <fstream>
+#include <future>
+#include <memory>
+#include <unordered_map>
 #include "ui/renderer.hpp"
 #include "env.hpp"
+#include "kernels.hpp"
+#include "movegen.hpp"
+#include "openingbook.hpp"
+#include "perfectclear.hpp"
+#include "search.hpp"
+#include "threadpool.hpp"
+
+constexpr double SEARCH_TIME_SHARE = 0.8;   // of the time between two pieces at the target pps
+constexpr int MAX_BEAM_WIDTH = 1024;
+constexpr int ROLLOUT_DEFAULT_PLIES = 10;
+
+// One first move of the two piece search, with the best reward found after it
+struct RootCandidate
+{
+    SearchNode node;
+    double reward = 0;
+    int duplicateOf = -1;   // earlier candidate ending in the same position
+    bool pruned = false;
+};
 
 class TetrisHeurAI : public TetrisEnv
 {
 public:
     TetrisHeurAI();
+    virtual ~TetrisHeurAI();
 
-    void Update();
+    virtual void Update();
     void Draw(const string& customTitle="", const string& customData="", const string& customSubData="");
     void UpdateHeuristics(HeuristicsWeights newWeights);
     void SetPPS(float pps);
+    void SetSpinSearch(bool enabled);
+    void SetGravity(float gravity);
+    void SetBeamSearch(int width, int depth=0);
+    void SetExpectimax(int plies, int branch=3);
+    void SetRollouts(int count, int plies=ROLLOUT_DEFAULT_PLIES);
+    void SetTranspositionTable(size_t megabytes, bool hugePages=false);
+    void SetThreads(int count);
+    void SetPondering(bool enabled);
+    void SetPruning(int minWidth, int maxWidth);
+    void SetPerfectClear(bool enabled);
+    void SetTSpinSetups(double weight);
+    void SetContour(double weight);
+    bool LoadOpeningBook(const string& path=BOOK_DEFAULT_PATH);
     
     void NewGame() override;
 
+    // The move last played, and every move since the last reset
+    const SearchStats& GetLastSearchStats() const;
+    const SearchStats& GetSearchTotals() const;
+    void ResetSearchStats();
+
 protected:
     float pps;
     int timer;
+    MovementModel movement;
+    int beamWidth;
+    int beamDepth;
+    int chancePlies;
+    int chanceBranch;
+    int rolloutCount;
+    int rolloutPlies;
+    int pruneMinWidth;
+    int pruneMaxWidth;
+    bool perfectClear;
 
+    SearchWorker worker;
+    TranspositionTable table;
+    size_t tableSize;
+    PerfectClearSolver pcSolver;
+    OpeningBook book;
+
+    unique_ptr<ThreadPool> threads;
+    vector<unique_ptr<SearchWorker>> workers;
+    vector<RootCandidate> candidates;
+    unordered_map<uint64_t, int> candidateKeys;
+    vector<SearchResult> results;
+    vector<char> finished;
     TetrisRenderer renderer;
+    SearchStats lastSearchStats;
+    SearchStats searchTotals;
+
+    // The move Update last made, set on the game thread only
+    BlockType playedType = EMPTY;
+    bool playedHold = false;
+    Placement playedPlacement = { INITIAL, 0, 0 };
+
+    // Last so it is waited for before anything it uses goes away
+    bool pondering;
+    future<SearchResult> ponder;
+
+    SearchNode MakeRoot();
+    vector<BlockType> MakeQueue();
+    void StopPondering();
+    SearchResult Search(const SearchNode& root, const vector<BlockType>& queue);
+    SearchStats CollectStats();
 
-    void FindBestMove(bool& useHold, int& bestMove, RotateState& bestRotation);
-    double SimulateMove(Block& block, RotateState s, int posX);
-    void TryMoves(Block& firstBlock, Block& secondBlock, double& bestReward, int& bestMove, RotateState& bestRotation);
+    virtual bool FindBestMove(const SearchNode& root, const vector<BlockType>& queue, bool& useHold,
+                              Placement& bestPlacement);
+    bool FindPerfectClear(const SearchNode& root, const vector<BlockType>& queue, bool& useHold,
+                          Placement& bestPlacement);
+    bool FindBookMove(const SearchNode& root, const vector<BlockType>& queue, bool& useHold,
+                      Placement& bestPlacement);
+    bool FindBeamMove(const SearchNode& root, const vector<BlockType>& queue, bool& useHold,
+                      Placement& bestPlacement);
+    bool RunBeamSearch(const SearchNode& root, const vector<BlockType>& queue, const BeamSettings& settings,
+                       SearchResult& best);
+    chrono::steady_clock::time_point SearchDeadline();
+    void MarkDuplicates(const vector<BlockType>& queue);
+    void PruneCandidates(const SearchNode& root);
+    void RunCandidates(const function<void(SearchWorker&, RootCandidate&)>& score);
 };
 
 #endif /* HEURISTICS_HPP */
@@ -0,0 +1,217 @@
+#ifndef KERNELS_HPP
+#define KERNELS_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <utility>
+#include "core/block.hpp"
+#include "core/board.hpp"
+#include "env.hpp"
+
+/* Column occupancy of a board, bit j of a column is set when row j is filled.
+ * An extra bit below the last row acts as the floor, so a drop always stops.
+ */
+typedef array<uint32_t, BOARD_WIDTH> ColumnMasks;
+constexpr uint32_t FLOOR_BIT = 1u << BOARD_HEIGHT;
+constexpr uint32_t ROWS_MASK = FLOOR_BIT - 1;
+
+inline ColumnMasks BuildColumnMasks(const Board& board)
+{
+    const auto& grid = board.GetBoard();
+    ColumnMasks cols;
+
+    for (size_t i = 0; i < BOARD_WIDTH; ++i)
+    {
+        uint32_t mask = FLOOR_BIT;
+        for (size_t j = 0; j < BOARD_HEIGHT; ++j)
+            mask |= uint32_t(grid[i][j] != EMPTY) << j;
+        cols[i] = mask;
+    }
+
+    return cols;
+}
+
+// Row occupancy of a board, bit i of a row is set when column i is filled
+typedef array<uint16_t, BOARD_HEIGHT> RowMasks;
+constexpr uint16_t FULL_ROW = (1u << BOARD_WIDTH) - 1;
+
+inline RowMasks BuildRowMasks(const Board& board)
+{
+    const auto& grid = board.GetBoard();
+    RowMasks rows = {};
+
+    for (size_t i = 0; i < BOARD_WIDTH; ++i)
+        for (size_t j = 0; j < BOARD_HEIGHT; ++j)
+            rows[j] |= uint16_t(grid[i][j] != EMPTY) << i;
+
+    return rows;
+}
+
+
+/* Everything the search needs to know about one piece in one rotation,
+ * baked at compile time from blockData so the inner loops below have
+ * constant trip counts and fully unrolled footprints.
+ */
+
+template <BlockType type, RotateState rotation>
+struct PieceKernel
+{
+    static constexpr array<Coord, TETROMINO_SIZE> minos = blockData[type][rotation];
+
+    static constexpr int minCol = min({ minos[0].x, minos[1].x, minos[2].x, minos[3].x });
+    static constexpr int maxCol = max({ minos[0].x, minos[1].x, minos[2].x, minos[3].x });
+    static constexpr int width = maxCol - minCol + 1;
+    static constexpr int minRow = min({ minos[0].y, minos[1].y, minos[2].y, minos[3].y });
+    static constexpr int maxRow = max({ minos[0].y, minos[1].y, minos[2].y, minos[3].y });
+
+    // Range of origin positions keeping the piece inside the board
+    static constexpr int firstX = -minCol;
+    static constexpr int lastX = BOARD_WIDTH - 1 - maxCol;
+
+    // Rows covered in each footprint column with the origin at row 0
+    static constexpr array<uint32_t, TETROMINO_SIZE> colMask = [] {
+        array<uint32_t, TETROMINO_SIZE> mask = {};
+        for (const Coord& mino : minos)
+            mask[mino.x - minCol] |= 1u << mino.y;
+        return mask;
+    }();
+
+    // Lowest covered row in each footprint column
+    static constexpr array<int, TETROMINO_SIZE> colBottom = [] {
+        array<int, TETROMINO_SIZE> bottom = {};
+        for (const Coord& mino : minos)
+            bottom[mino.x - minCol] = max(bottom[mino.x - minCol], mino.y);
+        return bottom;
+    }();
+
+    // Returns the hard drop row of the origin, or -1 if the piece cannot spawn
+    static int Drop(const ColumnMasks& cols, int posX)
+    {
+        return DropColumns(cols, posX, make_index_sequence<width>());
+    }
+
+    // Rows a fitting piece falls before landing, read off the column surfaces below it
+    static int FallDistance(const ColumnMasks& cols, int posX, int posY)
+    {
+        return FallColumns(cols, posX, posY, make_index_sequence<width>());
+    }
+
+    static bool Fits(const ColumnMasks& cols, int posX, int posY)
+    {
+        if (posX < firstX || posX > lastX || posY < -minRow || posY > BOARD_HEIGHT - 1 - maxRow)
+            return false;
+        return FitsColumns(cols, posX, posY, make_index_sequence<width>());
+    }
+
+    // Writes the piece cells, pass EMPTY to take them back out
+    static void Lock(Board& board, int posX, int posY, BlockType cell)
+    {
+        auto& grid = board.GetBoard();
+        [&]<size_t... M>(index_sequence<M...>) {
+            ((grid[posX + minos[M].x][posY + minos[M].y] = cell), ...);
+        }(make_index_sequence<TETROMINO_SIZE>());
+    }
+
+    static bool ClearsLines(const ColumnMasks& cols, int posX, int posY)
+    {
+        uint32_t fullRows = ROWS_MASK;
+        for (int i = 0; i < BOARD_WIDTH; ++i)
+        {
+            const int footprintCol = i - posX - minCol;
+            const bool covered = footprintCol >= 0 && footprintCol < width;
+            fullRows &= cols[i] | (covered ? colMask[footprintCol] << posY : 0);
+        }
+        return fullRows != 0;
+    }
+
+    /* Locks every reachable hard drop of this rotation into the board in turn
+     * and hands it to the visitor. The board is restored afterwards, from the
+     * saved copy if the visitor may have cleared rows, by erasing the four
+     * cells otherwise.
+     */
+    template <typename Visitor>
+    static void Visit(Board& board, const ColumnMasks& cols, const Board& orig, Visitor& visit)
+    {
+        for (int posX = firstX; posX <= lastX; ++posX)
+        {
+            const int posY = Drop(cols, posX);
+            if (posY < 0) continue;
+
+            const bool clears = ClearsLines(cols, posX, posY);
+            Lock(board, posX, posY, type);
+
+            visit(Placement{ rotation, posX, posY });
+
+            if (clears) board = orig;
+            else Lock(board, posX, posY, EMPTY);
+        }
+    }
+
+private:
+    template <size_t... C>
+    static int DropColumns(const ColumnMasks& cols, int posX, index_sequence<C...>)
+    {
+        if ((... | (cols[posX + minCol + C] & colMask[C])))
+            return -1;
+
+        return FallColumns(cols, posX, 0, index_sequence<C...>());
+    }
+
+    template <size_t... C>
+    static int FallColumns(const ColumnMasks& cols, int posX, int posY, index_sequence<C...>)
+    {
+        return min({ countr_zero(cols[posX + minCol + C] >> (posY + colBottom[C] + 1))... });
+    }
+
+    template <size_t... C>
+    static bool FitsColumns(const ColumnMasks& cols, int posX, int posY, index_sequence<C...>)
+    {
+        return !(... | (cols[posX + minCol + C] & (colMask[C] << posY)));
+    }
+};
+
+template <BlockType type, typename Visitor>
+void ForEachPlacement(Board& board, Visitor& visit)
+{
+    const ColumnMasks cols = BuildColumnMasks(board);
+    const Board orig = board;
+
+    [&]<size_t... R>(index_sequence<R...>) {
+        (PieceKernel<type, RotateState(R)>::Visit(board, cols, orig, visit), ...);
+    }(make_index_sequence<uniqueRotations[type]>());
+}
+
+// One specialised kernel per piece type, picked once per piece
+template <typename Visitor>
+constexpr array<void (*)(Board&, Visitor&), BLOCK_TYPES> placementKernels = {{
+    &ForEachPlacement<I, Visitor>,
+    &ForEachPlacement<J, Visitor>,
+    &ForEachPlacement<L, Visitor>,
+    &ForEachPlacement<O, Visitor>,
+    &ForEachPlacement<S, Visitor>,
+    &ForEachPlacement<T, Visitor>,
+    &ForEachPlacement<Z, Visitor>
+}};
+
+template <typename Visitor>
+void VisitPlacements(BlockType type, Board& board, Visitor& visit)
+{
+    placementKernels<Visitor>[type](board, visit);
+}
+
+// Calls f with the rotation as a compile-time constant
+template <typename F>
+decltype(auto) DispatchRotation(RotateState rotation, F&& f)
+{
+    switch (rotation)
+    {
+        case LEFT: return f(integral_constant<RotateState, LEFT>());
+        case DOWN: return f(integral_constant<RotateState, DOWN>());
+        case RIGHT: return f(integral_constant<RotateState, RIGHT>());
+        default: return f(integral_constant<RotateState, INITIAL>());
+    }
+}
+
+#endif /* KERNELS_HPP */
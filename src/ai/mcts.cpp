@@ -0,0 +1,287 @@
+#include <cmath>
+#include "mcts.hpp"
+
+TetrisMctsAI::TetrisMctsAI()
+    : nodeBudget(MCTS_DEFAULT_BUDGET)
+    , playedChild(-1)
+    , minValue(0)
+    , maxValue(0)
+{};
+
+// A ponder still running would call FindBestMove on a half destroyed object
+TetrisMctsAI::~TetrisMctsAI()
+{
+    StopPondering();
+}
+
+void TetrisMctsAI::SetNodeBudget(int nodes)
+{
+    StopPondering();
+    nodeBudget = max(nodes, MCTS_BRANCH + 1);
+    playedChild = -1;
+}
+
+void TetrisMctsAI::NewGame()
+{
+    TetrisHeurAI::NewGame();
+    playedChild = -1;
+}
+
+bool TetrisMctsAI::FindBestMove(const SearchNode& root, const vector<BlockType>& queue, bool& useHold,
+                                Placement& bestPlacement)
+{
+    if (FindPerfectClear(root, queue, useHold, bestPlacement) || FindBookMove(root, queue, useHold, bestPlacement))
+    {
+        playedChild = -1;
+        return true;
+    }
+
+    worker.Configure(weights, movement);
+
+    minValue = numeric_limits<double>::infinity();
+    maxValue = -numeric_limits<double>::infinity();
+
+    // Reserved up front for a kept subtree and the new nodes, node references
+    // stay valid while the tree grows
+    if (!ReuseTree(root, queue))
+    {
+        pool.clear();
+        pool.reserve(2 * nodeBudget);
+        pool.emplace_back();
+        pool[0].state = root;
+    }
+
+    // The budget counts the nodes this search adds, not the ones it kept
+    const int poolLimit = int(pool.size()) + nodeBudget;
+
+    const auto deadline = SearchDeadline();
+
+    for (int iteration = 0; iteration < nodeBudget; ++iteration)
+    {
+        // Every iteration after the first leaves a usable tree, stop wherever time runs out
+        if (iteration > 0 && iteration % MCTS_CLOCK_INTERVAL == 0 && chrono::steady_clock::now() >= deadline)
+            break;
+
+        path.assign(1, 0);
+        int index = 0;
+
+        while (pool[index].expanded && pool[index].childCount > 0)
+        {
+            index = SelectChild(index);
+            path.push_back(index);
+        }
+
+        MctsOutcome outcome;
+        if (!pool[index].expanded)
+        {
+            if (int(pool.size()) + MCTS_BRANCH > poolLimit) break;
+            outcome = ExpandNode(index, queue);
+        }
+        // End of the queue or a top out, nothing left to grow
+        else outcome = LeafOutcome(pool[index].state);
+
+        const double value = OutcomeValue(outcome);
+        minValue = min(minValue, value);
+        maxValue = max(maxValue, value);
+
+        for (int node : path)
+        {
+            pool[node].visits++;
+            pool[node].rewardSum += outcome.reward;
+            pool[node].depthSum += outcome.depth;
+        }
+    }
+
+    const MctsNode& top = pool[0];
+    if (top.childCount == 0) return false;
+
+    // The most visited move is the one the search trusts the most
+    int best = top.firstChild;
+    for (int i = top.firstChild; i < top.firstChild + top.childCount; ++i)
+        if (pool[i].visits > pool[best].visits
+            || (pool[i].visits == pool[best].visits && NodeValue(pool[i]) > NodeValue(pool[best])))
+            best = i;
+
+    playedChild = best;
+    useHold = pool[best].state.firstHold;
+    bestPlacement = pool[best].state.firstPlacement;
+    return true;
+}
+
+/* Re-roots the tree at the move played last, if the game really got there.
+ * The kept nodes are copied breadth first into the spare arena with their
+ * depth, reward and queue position made relative to the new root, and the
+ * arenas are swapped. Every outcome backed up through a kept node ran
+ * through the played move, so the node keeps its visits and only loses the
+ * played move's reward and depth from its sums.
+ *
+ * At most a node budget is kept, the shallowest part of the subtree. Nodes
+ * whose children did not fit keep their statistics and expand again.
+ */
+bool TetrisMctsAI::ReuseTree(const SearchNode& root, const vector<BlockType>& queue)
+{
+    if (playedChild < 0 || playedChild >= int(pool.size())) return false;
+
+    const SearchNode& played = pool[playedChild].state;
+    if (played.current != root.current || played.hold != root.hold
+        || played.stats.comboCount != root.stats.comboCount || played.stats.b2bChain != root.stats.b2bChain
+        || played.board.GetBoard() != root.board.GetBoard())
+        return false;
+
+    const int shift = played.next;
+    const int depthBase = played.depth;
+    const double rewardBase = played.reward;
+
+    spare.clear();
+    spare.reserve(2 * nodeBudget);
+    spare.push_back(pool[playedChild]);
+    spare[0].state = root;
+
+    for (size_t i = 0; i < spare.size(); ++i)
+    {
+        const int oldFirst = spare[i].firstChild;
+        int count = spare[i].expanded ? spare[i].childCount : 0;
+        spare[i].firstChild = int(spare.size());
+
+        if (int(spare.size()) + count > nodeBudget)
+        {
+            spare[i].expanded = false;
+            spare[i].childCount = 0;
+            count = 0;
+        }
+
+        for (int j = 0; j < count; ++j)
+        {
+            MctsNode& child = spare.emplace_back(pool[oldFirst + j]);
+            SearchNode& state = child.state;
+
+            state.next -= shift;
+            state.depth -= depthBase;
+            state.reward -= rewardBase;
+            state.firstHold = (i == 0) ? state.lastHold : spare[i].state.firstHold;
+            state.firstPlacement = (i == 0) ? state.lastPlacement : spare[i].state.firstPlacement;
+
+            // Lines that ran past the old queue may see their piece now
+            if (state.current == EMPTY && state.next - 1 < int(queue.size()))
+            {
+                state.current = queue[state.next - 1];
+                child.expanded = false;
+                child.childCount = 0;
+            }
+        }
+    }
+
+    for (MctsNode& node : spare)
+    {
+        node.rewardSum -= node.visits * rewardBase;
+        node.depthSum -= node.visits * depthBase;
+        minValue = min(minValue, NodeValue(node));
+        maxValue = max(maxValue, NodeValue(node));
+    }
+
+    swap(pool, spare);
+    playedChild = -1;
+    return true;
+}
+
+// UCT, with values rescaled to the range seen so far since rewards are unbounded
+int TetrisMctsAI::SelectChild(int parent)
+{
+    const MctsNode& node = pool[parent];
+    const double logVisits = log(double(node.visits));
+    const double range = (maxValue > minValue) ? maxValue - minValue : 1;
+
+    int best = node.firstChild;
+    double bestScore = -numeric_limits<double>::infinity();
+
+    for (int i = node.firstChild; i < node.firstChild + node.childCount; ++i)
+    {
+        const MctsNode& child = pool[i];
+        const double mean = (NodeValue(child) - minValue) / range;
+        const double score = mean + MCTS_EXPLORATION * sqrt(logVisits / child.visits);
+
+        if (score > bestScore)
+        {
+            bestScore = score;
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+/* Adds the best MCTS_BRANCH placements of the node as children, each seeded
+ * with its own outcome as a first visit, and returns the best of them.
+ */
+MctsOutcome TetrisMctsAI::ExpandNode(int index, const vector<BlockType>& queue)
+{
+    auto better = [](const SearchNode& a, const SearchNode& b) { return a.reward > b.reward; };
+    expansion.clear();
+
+    auto visit = [&](const SearchNode& child)
+    {
+        if (expansion.size() < MCTS_BRANCH)
+        {
+            expansion.push_back(child);
+            push_heap(expansion.begin(), expansion.end(), better);
+            return;
+        }
+
+        // Either this child or the weakest kept one is left out of the tree
+        worker.Stats().cutoffs++;
+        if (child.reward > expansion.front().reward)
+        {
+            pop_heap(expansion.begin(), expansion.end(), better);
+            expansion.back() = child;
+            push_heap(expansion.begin(), expansion.end(), better);
+        }
+    };
+
+    worker.Expand(pool[index].state, queue, visit);
+
+    pool[index].expanded = true;
+    pool[index].firstChild = int(pool.size());
+    pool[index].childCount = int(expansion.size());
+
+    if (expansion.empty()) return LeafOutcome(pool[index].state);
+
+    MctsOutcome best;
+    double bestValue = -numeric_limits<double>::infinity();
+    for (const SearchNode& state : expansion)
+    {
+        MctsNode& child = pool.emplace_back();
+        child.state = state;
+        child.visits = 1;
+        child.rewardSum = state.reward;
+        child.depthSum = state.depth;
+
+        const double value = NodeValue(child);
+        minValue = min(minValue, value);
+        maxValue = max(maxValue, value);
+
+        if (value > bestValue)
+        {
+            bestValue = value;
+            best = { state.reward, state.depth };
+        }
+    }
+
+    return best;
+}
+
+// A node without children is the end of the queue, or a top out
+MctsOutcome TetrisMctsAI::LeafOutcome(const SearchNode& state)
+{
+    return { state.reward + (state.current == EMPTY ? 0 : TOP_OUT_REWARD), state.depth };
+}
+
+// Mean reward per piece over the outcomes, so lines of different depths compare
+double TetrisMctsAI::NodeValue(const MctsNode& node)
+{
+    return node.depthSum > 0 ? node.rewardSum / node.depthSum : node.rewardSum / max(node.visits, 1);
+}
+
+double TetrisMctsAI::OutcomeValue(const MctsOutcome& outcome)
+{
+    return outcome.depth > 0 ? outcome.reward / outcome.depth : outcome.reward;
+}
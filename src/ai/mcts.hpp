@@ -0,0 +1,68 @@
+#ifndef MCTS_HPP
+#define MCTS_HPP
+
+#include <vector>
+#include "heuristics.hpp"
+
+constexpr int MCTS_DEFAULT_BUDGET = 1024;
+constexpr int MCTS_BRANCH = 8;            // best placements kept per expansion
+constexpr double MCTS_EXPLORATION = 1.4;
+constexpr int MCTS_CLOCK_INTERVAL = 16;   // iterations between deadline checks
+
+// Total reward and pieces placed of a line, counted from the root
+struct MctsOutcome
+{
+    double reward = 0;
+    int depth = 0;
+};
+
+struct MctsNode
+{
+    SearchNode state;
+    int firstChild = 0;     // children sit next to each other in the pool
+    int childCount = 0;
+    bool expanded = false;
+    int visits = 0;
+    double rewardSum = 0;   // over the outcomes backed up through the node
+    double depthSum = 0;
+};
+
+/* Plays like TetrisHeurAI but picks its moves with a Monte Carlo tree search
+ * over the piece queue. Leaves are valued with the heuristic reward of their
+ * best placement, and each search adds up to the node budget of new nodes.
+ * Nodes come from a pool reserved once, so a search allocates nothing.
+ *
+ * The subtree under the played move is carried over to the next piece with
+ * its statistics, so its placements are not generated and evaluated again.
+ */
+class TetrisMctsAI : public TetrisHeurAI
+{
+public:
+    TetrisMctsAI();
+    ~TetrisMctsAI();
+
+    void SetNodeBudget(int nodes);
+
+    void NewGame() override;
+
+protected:
+    int nodeBudget;
+    vector<MctsNode> pool;
+    vector<MctsNode> spare;     // second arena the kept subtree is copied into
+    int playedChild;
+    vector<SearchNode> expansion;
+    vector<int> path;
+    double minValue, maxValue;
+
+    bool FindBestMove(const SearchNode& root, const vector<BlockType>& queue, bool& useHold,
+                      Placement& bestPlacement) override;
+
+    bool ReuseTree(const SearchNode& root, const vector<BlockType>& queue);
+    int SelectChild(int parent);
+    MctsOutcome ExpandNode(int index, const vector<BlockType>& queue);
+    MctsOutcome LeafOutcome(const SearchNode& state);
+    double NodeValue(const MctsNode& node);
+    double OutcomeValue(const MctsOutcome& outcome);
+};
+
+#endif /* MCTS_HPP */
@@ -0,0 +1,380 @@
+#include "movegen.hpp"
+
+/* Cost is 0 before the piece touches down, then 1 + the inputs made since,
+ * every input after touching down uses up one lock reset in TetrisUI.
+ * Fall is the gravity gathered towards the next row, in 1/FALL_UNIT rows.
+ */
+struct MoveState
+{
+    RotateState rotation;
+    int posX, posY;
+    int cost;
+    int fall;
+};
+
+constexpr int FALL_UNIT = 1 << 15;
+
+/* Positions of one piece, each visited once free and once touched down,
+ * and again whenever it is reached with less of a row fallen. Revisits
+ * past MOVEGEN_REVISITS are dropped; only gravity just under a whole row
+ * per frame gets there, and then loses under 1% of the placements.
+ */
+constexpr int MOVEGEN_POSITIONS = ROTATION_STATES * MOVEGEN_COLS * MOVEGEN_ROWS;
+constexpr int MOVEGEN_REVISITS = MOVEGEN_POSITIONS;
+constexpr int MOVEGEN_STATES = 2 * MOVEGEN_POSITIONS + MOVEGEN_REVISITS;
+
+struct CanonicalPosition
+{
+    RotateState rotation;
+    int offsetX, offsetY;
+};
+
+/* For each rotation, the first rotation of the same piece covering the same
+ * cells and the origin shift between the two (I, S, Z and O repeat shapes)
+ */
+static constexpr array<array<CanonicalPosition, ROTATION_STATES>, BLOCK_TYPES> canonicalPositions = [] {
+    array<array<CanonicalPosition, ROTATION_STATES>, BLOCK_TYPES> table = {};
+
+    auto corner = [](const array<Coord, TETROMINO_SIZE>& minos)
+    {
+        Coord c = minos[0];
+        for (const Coord& mino : minos)
+            c = { min(c.x, mino.x), min(c.y, mino.y) };
+        return c;
+    };
+
+    for (int type = 0; type < BLOCK_TYPES; ++type)
+        for (int rot = 0; rot < ROTATION_STATES; ++rot)
+        {
+            const auto& minos = blockData[type][rot];
+            const Coord origin = corner(minos);
+
+            for (int other = 0; other <= rot; ++other)
+            {
+                const auto& otherMinos = blockData[type][other];
+                const Coord otherOrigin = corner(otherMinos);
+                bool sameShape = true;
+
+                for (const Coord& mino : minos)
+                {
+                    bool found = false;
+                    for (const Coord& otherMino : otherMinos)
+                        found |= (mino.x - origin.x == otherMino.x - otherOrigin.x
+                                  && mino.y - origin.y == otherMino.y - otherOrigin.y);
+                    sameShape &= found;
+                }
+
+                if (sameShape)
+                {
+                    table[type][rot] = { RotateState(other), origin.x - otherOrigin.x, origin.y - otherOrigin.y };
+                    break;
+                }
+            }
+        }
+
+    return table;
+}();
+
+template <BlockType type>
+static int FallAt(const ColumnMasks& cols, RotateState rotation, int posX, int posY)
+{
+    return DispatchRotation(rotation, [&](auto r)
+    {
+        return PieceKernel<type, decltype(r)::value>::FallDistance(cols, posX, posY);
+    });
+}
+
+template <BlockType type>
+static bool FitsAt(const ColumnMasks& cols, RotateState rotation, int posX, int posY)
+{
+    return DispatchRotation(rotation, [&](auto r)
+    {
+        return PieceKernel<type, decltype(r)::value>::Fits(cols, posX, posY);
+    });
+}
+
+// Walls, floor and the area above the board count as filled, as in Board::CheckFit
+static bool Occupied(const ColumnMasks& cols, int posX, int posY)
+{
+    if (posX < 0 || posX >= BOARD_WIDTH || posY < 0 || posY >= BOARD_HEIGHT)
+        return true;
+    return (cols[posX] >> posY) & 1;
+}
+
+// Same corner rules as TetrisUI::ValidateTSpin
+static SpinType ClassifyTSpin(const ColumnMasks& cols, const MoveState& s, bool lastKick)
+{
+    static const int checkPairs[4][2] = {
+        {0, 1},
+        {0, 2},
+        {2, 3},
+        {1, 3}
+    };
+
+    const bool corners[4] = {
+        Occupied(cols, s.posX, s.posY),
+        Occupied(cols, s.posX + 2, s.posY),
+        Occupied(cols, s.posX, s.posY + 2),
+        Occupied(cols, s.posX + 2, s.posY + 2)
+    };
+
+    int cornersTouched = corners[0] + corners[1] + corners[2] + corners[3];
+
+    if (cornersTouched <= 2) return NO_SPIN;
+    if (lastKick) return T_SPIN;
+    if (cornersTouched == 4) return T_SPIN_MINI;
+
+    const int* pair = checkPairs[s.rotation];
+    return (corners[pair[0]] && corners[pair[1]]) ? T_SPIN : T_SPIN_MINI;
+}
+
+template <BlockType type>
+static void Generate(const ColumnMasks& cols, const MovementModel& model, PlacementList& placements)
+{
+    // Per rotation and column, one bit per row: visited while free and once
+    // touched down, waiting to be visited once touched down, entered by a
+    // rotation after touching down, entered by the last SRS kick (TetrisUI
+    // treats that one as a full T-spin). A free visit does not stand in for
+    // a touched down one, only rotations from the latter can spin; the O
+    // never rotates and shares one set.
+    array<array<array<uint32_t, MOVEGEN_COLS>, ROTATION_STATES>, 2> visited = {};
+    array<array<uint32_t, MOVEGEN_COLS>, ROTATION_STATES> pending = {};
+    array<array<uint32_t, MOVEGEN_COLS>, ROTATION_STATES> rotated = {};
+    array<array<uint32_t, MOVEGEN_COLS>, ROTATION_STATES> kicked = {};
+
+    // Least fall each visited or pending position was reached with, only read
+    // where the bit above is set. A piece with less fall can follow every
+    // path of one with more, soft dropping where the other falls, so those
+    // visits are skipped.
+    typedef array<array<array<uint16_t, MOVEGEN_ROWS>, MOVEGEN_COLS>, ROTATION_STATES> FallTable;
+    array<FallTable, 2> visitedFall;
+    FallTable pendingFall;
+
+    // Positions still free to move are all expanded before touched down ones,
+    // so each position is first reached at its lowest cost
+    array<MoveState, MOVEGEN_STATES> queue;
+    array<MoveState, MOVEGEN_STATES> touchedDown;
+    int head = 0, tail = 0, touchedCount = 0, revisits = 0;
+
+    // Below 1G the fraction carries over, 1.5G drops one row then two
+    const bool instant = model.gravity >= MAX_GRAVITY;
+    const int gravityStep = instant ? 0 : int(model.gravity * FALL_UNIT + 0.5f);
+
+    auto phase = [](const MoveState& s) { return int(type != O && s.cost > 0); };
+
+    // True for a position new to the set, or reached with less fall than before
+    auto improves = [&](auto& seen, FallTable& leastFall, const MoveState& s)
+    {
+        const int col = s.posX + MOVEGEN_OFFSET;
+        const uint32_t bit = 1u << (s.posY + MOVEGEN_OFFSET);
+        uint16_t& least = leastFall[s.rotation][col][s.posY + MOVEGEN_OFFSET];
+
+        if (seen[s.rotation][col] & bit)
+        {
+            if (s.fall >= least || revisits == MOVEGEN_REVISITS) return false;
+            revisits++;
+        }
+
+        seen[s.rotation][col] |= bit;
+        least = uint16_t(s.fall);
+        return true;
+    };
+
+    auto enqueue = [&](const MoveState& s)
+    {
+        if (improves(visited[phase(s)], visitedFall[phase(s)], s))
+            queue[tail++] = s;
+    };
+
+    auto push = [&](MoveState s, bool byRotation, bool lastKick)
+    {
+        const int col = s.posX + MOVEGEN_OFFSET;
+        const uint32_t bit = 1u << (s.posY + MOVEGEN_OFFSET);
+
+        if (byRotation) rotated[s.rotation][col] |= bit;
+        if (lastKick) kicked[s.rotation][col] |= bit;
+
+        // Touching down from a free position, wait until all free ones are done
+        if (s.cost == 1)
+        {
+            if (improves(pending, pendingFall, s))
+                touchedDown[touchedCount++] = s;
+            return;
+        }
+
+        enqueue(s);
+    };
+
+    // One input then one frame of gravity. Soft drops run at the soft drop
+    // factor, far ahead of gravity, so they take no frame and restart the
+    // gravity timer as TetrisUI::SoftDrop does.
+    auto input = [&](const MoveState& from, RotateState rotation, int posX, int posY,
+                     bool softDrop, bool byRotation, bool lastKick)
+    {
+        const int progress = softDrop ? 0 : from.fall + gravityStep;
+        const int fall = progress % FALL_UNIT;
+        const int fallen = min(instant ? BOARD_HEIGHT : progress / FALL_UNIT,
+                               FallAt<type>(cols, rotation, posX, posY));
+        posY += fallen;
+
+        const bool landed = FallAt<type>(cols, rotation, posX, posY) == 0;
+        const int cost = from.cost ? from.cost + 1 : int((softDrop || fallen) && landed);
+
+        // TetrisUI only detects a spin once the piece touched down before rotating
+        if (fallen || !from.cost) byRotation = lastKick = false;
+
+        // Out of lock resets, the piece falls where it is and locks
+        if (cost > model.lockMoves && !landed)
+        {
+            posY += FallAt<type>(cols, rotation, posX, posY);
+            byRotation = lastKick = false;
+        }
+
+        push({ rotation, posX, posY, cost, fall }, byRotation, lastKick);
+    };
+
+    const int spawnX = (type == O) ? 4 : 3;
+    if (!FitsAt<type>(cols, INITIAL, spawnX, 0)) return;
+    input({ INITIAL, spawnX, 0, 0, 0 }, INITIAL, spawnX, 0, false, false, false);
+
+    const auto& kickTable = (type == I) ? IsrsData : srsData;
+
+    while (head < tail || touchedCount > 0)
+    {
+        // Free positions are exhausted, carry on from the ones that touched down
+        if (head == tail)
+        {
+            for (int i = 0; i < touchedCount; ++i)
+                enqueue(touchedDown[i]);
+            touchedCount = 0;
+            continue;
+        }
+
+        const MoveState s = queue[head++];
+        if (s.cost > model.lockMoves) continue;
+
+        if (FitsAt<type>(cols, s.rotation, s.posX - 1, s.posY))
+            input(s, s.rotation, s.posX - 1, s.posY, false, false, false);
+        if (FitsAt<type>(cols, s.rotation, s.posX + 1, s.posY))
+            input(s, s.rotation, s.posX + 1, s.posY, false, false, false);
+
+        // Soft drop by one row, or all the way down as TetrisUI::SoftDrop does
+        const int drop = FallAt<type>(cols, s.rotation, s.posX, s.posY);
+        if (drop > 0)
+        {
+            input(s, s.rotation, s.posX, s.posY + 1, true, false, false);
+            if (drop > 1) input(s, s.rotation, s.posX, s.posY + drop, true, false, false);
+        }
+
+        if (type == O) continue;
+
+        // Quarter turns, first kick that fits wins as in TetrisUI::Rotate
+        for (RotateState direction : { LEFT, RIGHT })
+        {
+            const RotateState newState = RotateState((s.rotation + direction) % ROTATION_STATES);
+            const auto& offsets = kickTable[s.rotation * 2 + (direction == RIGHT)].offsets;
+
+            for (size_t i = 0; i < offsets.size(); ++i)
+            {
+                const int posX = s.posX + offsets[i].x;
+                const int posY = s.posY + offsets[i].y;
+
+                if (FitsAt<type>(cols, newState, posX, posY))
+                {
+                    input(s, newState, posX, posY, false, true, i == 4);
+                    break;
+                }
+            }
+        }
+
+        // Half turns never count as a spin in TetrisUI
+        const RotateState oppositeState = RotateState((s.rotation + DOWN) % ROTATION_STATES);
+        auto tryOpposite = [&](const auto& offsets)
+        {
+            for (const Coord& offset : offsets)
+                if (FitsAt<type>(cols, oppositeState, s.posX + offset.x, s.posY + offset.y))
+                {
+                    input(s, oppositeState, s.posX + offset.x, s.posY + offset.y, false, false, false);
+                    return;
+                }
+        };
+
+        if (type == T) tryOpposite(TOppositeSrsData[s.rotation]);
+        else tryOpposite(OppositeSrsData[s.rotation]);
+    }
+
+    auto spinAt = [&](const MoveState& s)
+    {
+        const int col = s.posX + MOVEGEN_OFFSET;
+        const uint32_t bit = 1u << (s.posY + MOVEGEN_OFFSET);
+
+        if (!(rotated[s.rotation][col] & bit))
+            return NO_SPIN;
+
+        if (type == T)
+            return ClassifyTSpin(cols, s, kicked[s.rotation][col] & bit);
+
+        // Other pieces spin when they cannot move anywhere after the rotation
+        const bool immobile = !FitsAt<type>(cols, s.rotation, s.posX - 1, s.posY)
+                              && !FitsAt<type>(cols, s.rotation, s.posX + 1, s.posY)
+                              && !FitsAt<type>(cols, s.rotation, s.posX, s.posY - 1);
+        return immobile ? ALL_SPIN : NO_SPIN;
+    };
+
+    // Collapse duplicate shapes onto one rotation, keeping the best spin seen
+    array<array<uint32_t, MOVEGEN_COLS>, ROTATION_STATES> landed = {};
+    array<array<uint32_t, MOVEGEN_COLS>, ROTATION_STATES> spun = {};
+    array<MoveState, MOVEGEN_STATES> canonical;
+
+    for (int i = 0; i < tail; ++i)
+    {
+        const MoveState& s = queue[i];
+        const CanonicalPosition& c = canonicalPositions[type][s.rotation];
+        MoveState& cs = canonical[i];
+
+        cs = { c.rotation, s.posX + c.offsetX, s.posY + c.offsetY, s.cost, s.fall };
+        if (FallAt<type>(cols, s.rotation, s.posX, s.posY) > 0)
+        {
+            cs.posY = -MOVEGEN_OFFSET - 1;
+            continue;
+        }
+
+        const uint32_t bit = 1u << (cs.posY + MOVEGEN_OFFSET);
+        landed[cs.rotation][cs.posX + MOVEGEN_OFFSET] |= bit;
+        if (type != T && spinAt(s) == ALL_SPIN)
+            spun[cs.rotation][cs.posX + MOVEGEN_OFFSET] |= bit;
+    }
+
+    for (int i = 0; i < tail; ++i)
+    {
+        const MoveState& cs = canonical[i];
+        if (cs.posY < -MOVEGEN_OFFSET) continue;
+
+        const int col = cs.posX + MOVEGEN_OFFSET;
+        const uint32_t bit = 1u << (cs.posY + MOVEGEN_OFFSET);
+        if (!(landed[cs.rotation][col] & bit)) continue;
+        landed[cs.rotation][col] &= ~bit;
+
+        SpinType spin = NO_SPIN;
+        if (type == T) spin = spinAt(queue[i]);
+        else if (spun[cs.rotation][col] & bit) spin = ALL_SPIN;
+
+        placements.items[placements.count++] = { cs.rotation, cs.posX, cs.posY, spin };
+    }
+}
+
+static constexpr array<void (*)(const ColumnMasks&, const MovementModel&, PlacementList&), BLOCK_TYPES> generators = {{
+    &Generate<I>,
+    &Generate<J>,
+    &Generate<L>,
+    &Generate<O>,
+    &Generate<S>,
+    &Generate<T>,
+    &Generate<Z>
+}};
+
+void GenerateReachable(const ColumnMasks& cols, BlockType type, PlacementList& placements, const MovementModel& model)
+{
+    placements.count = 0;
+    generators[type](cols, model, placements);
+}
@@ -0,0 +1,98 @@
+#ifndef MOVEGEN_HPP
+#define MOVEGEN_HPP
+
+#include <limits>
+#include "kernels.hpp"
+
+/* Origins a piece can occupy: kicks never push a valid piece further
+ * than two columns left of the board, or two rows above it.
+ */
+constexpr int MOVEGEN_OFFSET = 2;
+constexpr int MOVEGEN_COLS = BOARD_WIDTH + MOVEGEN_OFFSET;
+constexpr int MOVEGEN_ROWS = BOARD_HEIGHT + MOVEGEN_OFFSET;
+
+// Distinct resting positions never exceed one per rotation and cell
+constexpr int MAX_PLACEMENTS = ROTATION_STATES * BOARD_WIDTH * BOARD_HEIGHT;
+
+struct PlacementList
+{
+    array<Placement, MAX_PLACEMENTS> items;
+    int count = 0;
+};
+
+/* How fast pieces fall and how long they may keep moving once they touched
+ * down, following TetrisUI. One input is made per frame and gravity below
+ * 1G builds up over several of them, 0.5G drops the piece a row every
+ * second input. Soft drops take no frame. The defaults are no gravity and
+ * no lock delay at all.
+ */
+struct MovementModel
+{
+    float gravity = 0;                          // rows per frame, up to MAX_GRAVITY
+    int lockMoves = numeric_limits<int>::max(); // inputs allowed after touching down
+    bool spins = false;                         // also look for rotations into place
+};
+
+/* Finds every resting position reachable from spawn with shifts, soft drops
+ * and SRS rotations (kick tables from block.hpp) under the movement model,
+ * and tags each one with the spin it would score if the last input was a
+ * rotation. Positions with the same cells under different rotations are
+ * reported once.
+ */
+void GenerateReachable(const ColumnMasks& cols, BlockType type, PlacementList& placements,
+                       const MovementModel& model = MovementModel());
+
+template <BlockType type, typename Visitor>
+void ForEachReachable(Board& board, Visitor& visit, const MovementModel& model)
+{
+    const ColumnMasks cols = BuildColumnMasks(board);
+    const Board orig = board;
+
+    PlacementList placements;
+    GenerateReachable(cols, type, placements, model);
+
+    for (int i = 0; i < placements.count; ++i)
+    {
+        const Placement& placement = placements.items[i];
+
+        DispatchRotation(placement.rotation, [&](auto rotation)
+        {
+            typedef PieceKernel<type, decltype(rotation)::value> Kernel;
+
+            const bool clears = Kernel::ClearsLines(cols, placement.posX, placement.posY);
+            Kernel::Lock(board, placement.posX, placement.posY, type);
+
+            visit(placement);
+
+            if (clears) board = orig;
+            else Kernel::Lock(board, placement.posX, placement.posY, EMPTY);
+        });
+    }
+}
+
+template <typename Visitor>
+constexpr array<void (*)(Board&, Visitor&, const MovementModel&), BLOCK_TYPES> reachableKernels = {{
+    &ForEachReachable<I, Visitor>,
+    &ForEachReachable<J, Visitor>,
+    &ForEachReachable<L, Visitor>,
+    &ForEachReachable<O, Visitor>,
+    &ForEachReachable<S, Visitor>,
+    &ForEachReachable<T, Visitor>,
+    &ForEachReachable<Z, Visitor>
+}};
+
+template <typename Visitor>
+void VisitReachable(BlockType type, Board& board, Visitor& visit, const MovementModel& model = MovementModel())
+{
+    reachableKernels<Visitor>[type](board, visit, model);
+}
+
+// Hard drops from the top unless spins or gravity call for the full move generator
+template <typename Visitor>
+void VisitMoves(BlockType type, Board& board, Visitor& visit, const MovementModel& model)
+{
+    if (model.spins || model.gravity > 0) VisitReachable(type, board, visit, model);
+    else VisitPlacements(type, board, visit);
+}
+
+#endif /* MOVEGEN_HPP */
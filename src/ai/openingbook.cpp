@@ -0,0 +1,156 @@
+#include <bit>
+#include <fstream>
+#include "openingbook.hpp"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+uint64_t BookKey(const SearchNode& node, const vector<BlockType>& queue)
+{
+    uint64_t key = HashColumns(BuildColumnMasks(node.board));
+
+    for (int i = node.next; i < node.next + BOOK_PREVIEW; ++i)
+        key = SplitMix64(key ^ (i < int(queue.size()) ? queue[i] : EMPTY));
+
+    key = SplitMix64(key ^ (uint64_t(node.current) | uint64_t(node.hold) << 4));
+    key = SplitMix64(key ^ uint32_t(node.stats.comboCount));
+    key = SplitMix64(key ^ uint32_t(node.stats.b2bChain));
+    return key ? key : 1;
+}
+
+uint64_t BookWeightsHash(const HeuristicsWeights& weights)
+{
+    uint64_t hash = 0;
+
+    for (double weight : { weights.holeCount, weights.aggrHeight, weights.maxHeight, weights.bumpiness,
+                           weights.rowTransition, weights.colTransition, weights.multiWell, weights.wellDepth,
+                           weights.gameScore, weights.tSpinSetup, weights.contour })
+        hash = SplitMix64(hash ^ bit_cast<uint64_t>(weight));
+
+    return hash;
+}
+
+OpeningBook::~OpeningBook()
+{
+    Close();
+}
+
+bool OpeningBook::Load(const string& path)
+{
+    Close();
+
+    BookHeader header;
+    ifstream f(path, ios::binary);
+    if (!f.is_open() || !f.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+
+    f.seekg(0, ios::end);
+    const size_t fileSize = size_t(f.tellg());
+
+    if (header.magic != BOOK_MAGIC || header.version != BOOK_VERSION || !has_single_bit(header.slotCount)
+        || fileSize != sizeof(BookHeader) + header.slotCount * sizeof(BookEntry))
+        return false;
+
+#ifdef __linux__
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        void* memory = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+
+        if (memory != MAP_FAILED)
+        {
+            mapping = memory;
+            mappedBytes = fileSize;
+            slots = reinterpret_cast<const BookEntry*>(static_cast<const char*>(memory) + sizeof(BookHeader));
+            slotCount = header.slotCount;
+            weightsHash = header.weightsHash;
+            return true;
+        }
+    }
+#endif
+
+    loaded.resize(header.slotCount);
+    f.seekg(sizeof(BookHeader));
+    if (!f.read(reinterpret_cast<char*>(loaded.data()), streamsize(header.slotCount * sizeof(BookEntry))))
+    {
+        loaded.clear();
+        return false;
+    }
+
+    slots = loaded.data();
+    slotCount = header.slotCount;
+    weightsHash = header.weightsHash;
+    return true;
+}
+
+void OpeningBook::Close()
+{
+#ifdef __linux__
+    if (mapping) munmap(mapping, mappedBytes);
+#endif
+
+    mapping = nullptr;
+    mappedBytes = 0;
+    loaded.clear();
+    slots = nullptr;
+    slotCount = 0;
+    weightsHash = 0;
+}
+
+bool OpeningBook::IsOpen() const
+{
+    return slots != nullptr;
+}
+
+uint64_t OpeningBook::WeightsHash() const
+{
+    return weightsHash;
+}
+
+bool OpeningBook::Probe(const SearchNode& root, const vector<BlockType>& queue, bool& useHold,
+                        Placement& placement) const
+{
+    if (!slots) return false;
+
+    const uint64_t key = BookKey(root, queue);
+
+    for (uint64_t i = 0; i < slotCount; ++i)
+    {
+        const BookEntry& entry = slots[(key + i) & (slotCount - 1)];
+        if (entry.key == 0) return false;
+        if (entry.key != key) continue;
+
+        UnpackMove(entry.move, useHold, placement);
+        return true;
+    }
+
+    return false;
+}
+
+bool OpeningBook::Write(const string& path, const vector<BookEntry>& entries, uint64_t weightsHash)
+{
+    BookHeader header = { BOOK_MAGIC, BOOK_VERSION, bit_ceil(max<uint64_t>(entries.size() * 2, 1)), weightsHash };
+    vector<BookEntry> table(header.slotCount, BookEntry());
+
+    for (const BookEntry& entry : entries)
+        for (uint64_t i = 0; i < header.slotCount; ++i)
+        {
+            BookEntry& slot = table[(entry.key + i) & (header.slotCount - 1)];
+            if (slot.key == entry.key) break;
+            if (slot.key != 0) continue;
+
+            slot = entry;
+            break;
+        }
+
+    ofstream f(path, ios::binary);
+    if (!f.is_open()) return false;
+
+    f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    f.write(reinterpret_cast<const char*>(table.data()), streamsize(table.size() * sizeof(BookEntry)));
+    return bool(f);
+}
@@ -0,0 +1,71 @@
+#ifndef OPENINGBOOK_HPP
+#define OPENINGBOOK_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "search.hpp"
+#include "transposition.hpp"
+
+constexpr const char* BOOK_DEFAULT_PATH = "opening.book";
+constexpr int BOOK_PREVIEW = 5;                 // queue pieces a book position covers
+constexpr uint32_t BOOK_MAGIC = 0x4b4f4254;     // "TBOK"
+constexpr uint32_t BOOK_VERSION = 2;
+
+struct BookHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t slotCount;     // a power of two
+    uint64_t weightsHash;   // BookWeightsHash of the weights the moves were searched with
+};
+
+// A key of 0 marks an empty slot
+struct BookEntry
+{
+    uint64_t key;
+    uint32_t move;          // PackMove
+    uint32_t unused;
+};
+
+// Board, pieces in play, the first BOOK_PREVIEW of the queue, combo and b2b
+uint64_t BookKey(const SearchNode& node, const vector<BlockType>& queue);
+
+// Every weight, the untrained ones included, since they all change the moves
+uint64_t BookWeightsHash(const HeuristicsWeights& weights);
+
+/* Moves precomputed offline for early positions (see tools/bookbuilder.cpp),
+ * kept in an open addressing table that is mapped into memory as it is.
+ * Lookups read a slot or two and never allocate.
+ */
+class OpeningBook
+{
+public:
+    OpeningBook() {};
+    ~OpeningBook();
+
+    OpeningBook(const OpeningBook&) = delete;
+    OpeningBook& operator=(const OpeningBook&) = delete;
+
+    // False, and no book, if the file is missing or not a book
+    bool Load(const string& path);
+    void Close();
+    bool IsOpen() const;
+    uint64_t WeightsHash() const;
+
+    bool Probe(const SearchNode& root, const vector<BlockType>& queue, bool& useHold, Placement& placement) const;
+
+    // Lays the entries out at half load, later duplicates of a key are dropped
+    static bool Write(const string& path, const vector<BookEntry>& entries, uint64_t weightsHash);
+
+private:
+    const BookEntry* slots = nullptr;
+    uint64_t slotCount = 0;
+    uint64_t weightsHash = 0;
+
+    void* mapping = nullptr;
+    size_t mappedBytes = 0;
+    vector<BookEntry> loaded;   // where the file cannot be mapped
+};
+
+#endif /* OPENINGBOOK_HPP */
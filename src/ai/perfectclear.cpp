@@ -0,0 +1,187 @@
+#include <bit>
+#include "perfectclear.hpp"
+
+constexpr uint64_t ROW_BITS = (1ull << BOARD_WIDTH) - 1;
+
+// Every row of a field one more than the highest target, the row just above it included
+constexpr uint64_t FieldColumns(int column, int step)
+{
+    uint64_t mask = 0;
+    for (int row = 0; row <= PC_MAX_HEIGHT; ++row)
+        for (int x = column; x < BOARD_WIDTH; x += step)
+            mask |= 1ull << (row * BOARD_WIDTH + x);
+    return mask;
+}
+
+constexpr uint64_t LEFT_COLUMN = FieldColumns(0, BOARD_WIDTH);
+constexpr uint64_t RIGHT_COLUMN = FieldColumns(BOARD_WIDTH - 1, BOARD_WIDTH);
+constexpr uint64_t EVEN_COLUMNS = FieldColumns(0, 2);
+
+void PerfectClearSolver::Configure(const MovementModel& movement)
+{
+    this->movement = movement;
+}
+
+bool PerfectClearSolver::Solve(const SearchNode& root, const vector<BlockType>& queue, PerfectClear& result)
+{
+    result = PerfectClear();
+
+    int stackHeight = 0;
+    int filled = 0;
+    for (uint32_t col : BuildColumnMasks(root.board))
+    {
+        stackHeight = max(stackHeight, BOARD_HEIGHT - countr_zero(col));
+        filled += popcount(col & ROWS_MASK);
+    }
+
+    if (stackHeight > PC_MAX_HEIGHT) return false;
+    rootScore = root.stats.score;
+
+    for (int height = max(stackHeight, 1); height <= PC_MAX_HEIGHT; ++height)
+    {
+        const int emptyCells = height * BOARD_WIDTH - filled;
+        if (emptyCells % 4 != 0) continue;
+
+        const int pieces = emptyCells / 4;
+        if (pieces > PC_MAX_PIECES) break;
+
+        if (!Fillable(ReadField(root.board, height), height, pieces, queue, root.current, root.hold, root.next))
+            continue;
+
+        visited.clear();
+        nodes = 0;
+        levels[0] = root.board;
+
+        Search(queue, root.stats, root.current, root.hold, root.next, 0, height, pieces, result);
+        if (result.found) return true;
+    }
+
+    return false;
+}
+
+/* Positions are told apart by field, pieces and queue position alone, so
+ * one reached again in another order is skipped even if its combo differs.
+ */
+void PerfectClearSolver::Search(const vector<BlockType>& queue, const GameStats& parentStats, BlockType current,
+                                BlockType hold, int next, int depth, int height, int piecesLeft, PerfectClear& result)
+{
+    if (current == EMPTY || nodes > PC_NODE_LIMIT) return;
+
+    const uint64_t key = ReadField(levels[depth], height)
+        | uint64_t(height) << 50 | uint64_t(current) << 53 | uint64_t(hold) << 56 | uint64_t(next) << 59;
+    if (!visited.insert(key).second) return;
+
+    auto pieceAt = [&](int i) { return i < int(queue.size()) ? queue[i] : EMPTY; };
+
+    auto placeAll = [&](BlockType piece, BlockType nextCurrent, BlockType nextHold, int nextIndex, bool usedHold)
+    {
+        auto onPlacement = [&](const Placement& placement)
+        {
+            if (++nodes > PC_NODE_LIMIT) return;
+
+            // A piece is connected, so one sticking out of the field shows in the row right above it
+            uint64_t field = ReadField(levels[depth], height + 1);
+            if (field >> (height * BOARD_WIDTH)) return;
+
+            uint64_t remaining = 0;
+            int remainingHeight = 0;
+            for (int row = 0; row < height; ++row)
+            {
+                const uint64_t bits = (field >> (row * BOARD_WIDTH)) & ROW_BITS;
+                if (bits == ROW_BITS) continue;
+                remaining |= bits << (remainingHeight++ * BOARD_WIDTH);
+            }
+
+            if (!Fillable(remaining, remainingHeight, piecesLeft - 1, queue, nextCurrent, nextHold, nextIndex))
+                return;
+
+            board = levels[depth];
+            stats = parentStats;
+            CalcScore(placement.spin);
+            path[depth] = { usedHold, placement };
+
+            if (piecesLeft == 1)
+            {
+                const int score = stats.score - rootScore;
+                if (board.CheckFullClear() && (!result.found || score > result.score))
+                {
+                    result.found = true;
+                    result.pieces = depth + 1;
+                    result.score = score;
+                    result.steps = path;
+                }
+                return;
+            }
+
+            const GameStats childStats = stats;
+            levels[depth + 1] = board;
+            Search(queue, childStats, nextCurrent, nextHold, nextIndex, depth + 1, remainingHeight,
+                   piecesLeft - 1, result);
+        };
+
+        VisitMoves(piece, levels[depth], onPlacement, movement);
+    };
+
+    placeAll(current, pieceAt(next), hold, next + 1, false);
+
+    // Same hold rules as SearchWorker::Expand
+    if (hold == EMPTY && pieceAt(next) != EMPTY)
+        placeAll(pieceAt(next), pieceAt(next + 1), current, next + 2, true);
+    else if (hold != EMPTY && hold != current)
+        placeAll(hold, pieceAt(next), current, next + 1, true);
+}
+
+bool PerfectClearSolver::Fillable(uint64_t field, int height, int piecesLeft, const vector<BlockType>& queue,
+                                  BlockType current, BlockType hold, int next) const
+{
+    const uint64_t zone = (1ull << (height * BOARD_WIDTH)) - 1;
+    const uint64_t empty = ~field & zone;
+    if (popcount(empty) != 4 * piecesLeft) return false;
+
+    const int available = (current != EMPTY) + (hold != EMPTY) + max(int(queue.size()) - next, 0);
+    if (available < piecesLeft) return false;
+
+    // The pieces used are among the current, the held and the next piecesLeft ones
+    int slack = 0;
+    auto addSlack = [&](BlockType type)
+    {
+        if (type == I) slack += 4;
+        else if (type == J || type == L || type == T) slack += 2;
+    };
+
+    addSlack(current);
+    addSlack(hold);
+    for (int i = next; i < min(next + piecesLeft, int(queue.size())); ++i)
+        addSlack(queue[i]);
+
+    if (abs(popcount(empty & EVEN_COLUMNS) - popcount(empty & ~EVEN_COLUMNS)) > slack) return false;
+
+    // Flood fills each enclosed area from its lowest cell
+    uint64_t rest = empty;
+    while (rest)
+    {
+        uint64_t area = rest & -rest;
+        while (true)
+        {
+            const uint64_t grown = (area | ((area << 1) & ~LEFT_COLUMN) | ((area >> 1) & ~RIGHT_COLUMN)
+                                   | (area << BOARD_WIDTH) | (area >> BOARD_WIDTH)) & empty;
+            if (grown == area) break;
+            area = grown;
+        }
+
+        if (popcount(area) % 4 != 0) return false;
+        rest &= ~area;
+    }
+
+    return true;
+}
+
+uint64_t PerfectClearSolver::ReadField(const Board& source, int height) const
+{
+    uint64_t field = 0;
+    for (int row = 0; row < height; ++row)
+        for (int x = 0; x < BOARD_WIDTH; ++x)
+            if (source.GetCell(x, BOARD_HEIGHT - 1 - row) != EMPTY)
+                field |= 1ull << (row * BOARD_WIDTH + x);
+    return field;
+}
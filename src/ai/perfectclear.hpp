@@ -0,0 +1,69 @@
+#ifndef PERFECTCLEAR_HPP
+#define PERFECTCLEAR_HPP
+
+#include <array>
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+#include "env.hpp"
+#include "movegen.hpp"
+#include "search.hpp"
+
+constexpr int PC_MAX_HEIGHT = 4;        // highest stack the solver is tried on
+constexpr int PC_MAX_PIECES = 10;       // a four row clear from an empty board
+constexpr int PC_NODE_LIMIT = 100000;   // placements tried before giving up
+
+struct PerfectClearStep
+{
+    bool useHold = false;
+    Placement placement = { INITIAL, 0, 0 };
+};
+
+struct PerfectClear
+{
+    bool found = false;
+    int pieces = 0;
+    int score = 0;      // points earned on the way, full clear bonus included
+    array<PerfectClearStep, PC_MAX_PIECES> steps;
+};
+
+/* Looks for a sequence of the known pieces that clears the whole board.
+ * Only the rows up to the target height are ever filled, so the board is
+ * kept as a 10-bit row per line of one 64-bit word, bottom row first.
+ *
+ * A position is dropped as soon as the empty cells left cannot be filled:
+ * too many for the pieces left, an enclosed area that is no multiple of
+ * four, or more cells in even than in odd columns than the J, L, T and I
+ * pieces left can make up for (all others cover two of each). The area
+ * test assumes no line clear joins two areas, so a few rare solutions are
+ * missed, but whatever is found is played exactly as searched.
+ */
+class PerfectClearSolver : public TetrisEnv
+{
+public:
+    PerfectClearSolver() {};
+
+    void Configure(const MovementModel& movement);
+
+    // Tries the lowest target height first, the solution scoring the most points there wins
+    bool Solve(const SearchNode& root, const vector<BlockType>& queue, PerfectClear& result);
+
+private:
+    MovementModel movement;
+    array<Board, PC_MAX_PIECES + 1> levels;
+    array<PerfectClearStep, PC_MAX_PIECES> path;
+    unordered_set<uint64_t> visited;
+
+    int rootScore = 0;
+    int nodes = 0;
+
+    void Search(const vector<BlockType>& queue, const GameStats& parentStats, BlockType current, BlockType hold,
+                int next, int depth, int height, int piecesLeft, PerfectClear& result);
+
+    bool Fillable(uint64_t field, int height, int piecesLeft, const vector<BlockType>& queue,
+                  BlockType current, BlockType hold, int next) const;
+
+    uint64_t ReadField(const Board& source, int height) const;
+};
+
+#endif /* PERFECTCLEAR_HPP */
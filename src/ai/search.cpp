@@ -0,0 +1,428 @@
+#include "search.hpp"
+
+// Keeps the entries of each kind of search apart in the shared table
+constexpr uint64_t BEAM_SALT = 0x6265616d;
+constexpr uint64_t EXPECTIMAX_SALT = 0x65787063;
+constexpr uint64_t ROLLOUT_SALT = 0x726f6c6c;
+
+void SearchWorker::Configure(const HeuristicsWeights& weights, const MovementModel& movement)
+{
+    this->weights = weights;
+    this->movement = movement;
+}
+
+void SearchWorker::SetTable(TranspositionTable* table)
+{
+    this->table = table;
+}
+
+SearchStats& SearchStats::operator+=(const SearchStats& other)
+{
+    decisions += other.decisions;
+    nodes += other.nodes;
+    evaluations += other.evaluations;
+    tableProbes += other.tableProbes;
+    tableHits += other.tableHits;
+    cutoffs += other.cutoffs;
+    depth += other.depth;
+    time += other.time;
+    return *this;
+}
+
+double SearchStats::BranchingFactor() const
+{
+    if (depth == 0 || evaluations == 0) return 0;
+    return pow(double(evaluations) / max(decisions, 1), 1.0 / AverageDepth());
+}
+
+SearchStats& SearchWorker::Stats()
+{
+    return counters;
+}
+
+void SearchWorker::ResetStats()
+{
+    counters = SearchStats();
+}
+
+uint64_t SearchWorker::NodeKey(const SearchNode& node, const vector<BlockType>& queue, uint64_t salt)
+{
+    uint64_t key = HashColumns(BuildColumnMasks(node.board)) ^ salt;
+
+    for (size_t i = node.next; i < queue.size(); ++i)
+        key = SplitMix64(key ^ queue[i]);
+
+    key = SplitMix64(key ^ (uint64_t(node.current) | uint64_t(node.hold) << 4));
+    key = SplitMix64(key ^ uint32_t(node.stats.comboCount));
+    return SplitMix64(key ^ uint32_t(node.stats.b2bChain));
+}
+
+double SearchWorker::BestChildReward(const SearchNode& node, const vector<BlockType>& queue)
+{
+    double best = -numeric_limits<double>::infinity();
+
+    auto visit = [&](const SearchNode& child) { best = max(best, child.reward); };
+    Expand(node, queue, visit);
+
+    // The next piece cannot spawn anymore, keep it as a last resort
+    return (best == -numeric_limits<double>::infinity()) ? node.reward + TOP_OUT_REWARD : best;
+}
+
+bool SearchWorker::BeamSearch(const SearchNode& root, const vector<BlockType>& queue, const BeamSettings& settings,
+                              SearchResult& result)
+{
+    // Min-heap on the reward, the front is the first node to drop
+    auto better = [](const SearchNode& a, const SearchNode& b) { return a.reward > b.reward; };
+
+    // Odd variants run a wider beam, and every variant expands the beam from
+    // another node first, so the nodes they leave in the table differ
+    const int width = settings.width + (settings.variant % 2) * settings.width / 4;
+
+    deadline = settings.deadline;
+    interrupted = false;
+    result = SearchResult();
+
+    beam.assign(1, root);
+
+    for (int ply = 0; ply < settings.depth; ++ply)
+    {
+        const size_t keep = max(1, width / (ply + 1));
+        children.clear();
+
+        auto visit = [&](const SearchNode& child)
+        {
+            // The same pieces placed in another order, only the better path goes
+            // on. Each variant only meets its own entries, so another thread
+            // never drops a node from this beam
+            if (table)
+            {
+                const uint64_t key = NodeKey(child, queue, BEAM_SALT ^ uint64_t(settings.variant) << 32);
+                TTResult seen;
+
+                counters.tableProbes++;
+                if (table->Probe(key, seen) && seen.current && seen.depth == child.depth
+                    && seen.value >= float(child.reward))
+                {
+                    counters.tableHits++;
+                    counters.cutoffs++;
+                    return;
+                }
+
+                table->Store(key, child.reward, child.depth, child.firstHold, child.firstPlacement);
+            }
+
+            if (children.size() < keep)
+            {
+                children.push_back(child);
+                push_heap(children.begin(), children.end(), better);
+                return;
+            }
+
+            // Either this child or the weakest kept one falls off the beam
+            counters.cutoffs++;
+            if (child.reward > children.front().reward)
+            {
+                pop_heap(children.begin(), children.end(), better);
+                children.back() = child;
+                push_heap(children.begin(), children.end(), better);
+            }
+        };
+
+        const size_t first = size_t(settings.variant) % beam.size();
+        for (size_t i = 0; i < beam.size(); ++i)
+        {
+            // Out of time, the last finished depth stands. The first one always
+            // finishes, a late move beats none at all
+            if (result.found && TimeUp()) return false;
+            Expand(beam[(first + i) % beam.size()], queue, visit);
+        }
+
+        // Every line tops out or the queue ran dry, settle for what the last depth saw
+        if (children.empty()) break;
+        swap(beam, children);
+
+        // Each finished depth is an answer already, should time run out further down
+        RecordBest(result);
+    }
+
+    // Look past the leaves, into the pieces the queue does not show yet
+    if (settings.chancePlies > 0 && result.found)
+    {
+        if (levels.size() < size_t(settings.chancePlies)) levels.resize(settings.chancePlies);
+        for (SearchNode& node : beam)
+        {
+            node.reward += Expectimax(node, queue, settings.chancePlies, max(settings.chanceBranch, 1));
+            if (interrupted) return false;
+        }
+
+        RecordBest(result);
+        result.stage = EXPECTIMAX_STAGE;
+    }
+
+    if (settings.rollouts > 0 && settings.rolloutPlies > 0 && result.found)
+    {
+        if (!RolloutLeaves(root, queue, settings)) return false;
+        RecordBest(result);
+        result.stage = ROLLOUT_STAGE;
+    }
+
+    return true;
+}
+
+/* The threads share their playouts through the table and each starts at
+ * its own share of the leaves, so together they play out the beam about once.
+ */
+bool SearchWorker::RolloutLeaves(const SearchNode& root, const vector<BlockType>& queue, const BeamSettings& settings)
+{
+    // Same futures for every leaf of the decision, whichever thread plays them
+    const uint64_t seed = NodeKey(root, queue, ROLLOUT_SALT);
+    const uint64_t salt = SplitMix64(ROLLOUT_SALT ^ uint64_t(settings.rollouts) << 16);
+
+    // Best first, so the variants line up on the same leaves
+    sort(beam.begin(), beam.end(), [](const SearchNode& a, const SearchNode& b) { return a.reward > b.reward; });
+
+    // Longer playouts than the table stores a depth for could not be told apart
+    const bool cached = table && settings.rolloutPlies <= TT_MAX_DEPTH;
+
+    const size_t first = size_t(settings.variant) * beam.size() / max(settings.variants, 1);
+    for (size_t i = 0; i < beam.size(); ++i)
+    {
+        if (TimeUp()) return false;
+        SearchNode& leaf = beam[(first + i) % beam.size()];
+
+        uint64_t key = 0;
+        if (cached)
+        {
+            key = NodeKey(leaf, queue, salt);
+            TTResult seen;
+
+            // Futures are drawn per decision, older playouts saw other ones
+            counters.tableProbes++;
+            if (table->Probe(key, seen) && seen.current && seen.depth == settings.rolloutPlies)
+            {
+                counters.tableHits++;
+                leaf.reward += seen.value;
+                continue;
+            }
+        }
+
+        const double value = Rollouts(leaf, queue, settings.rollouts, settings.rolloutPlies, seed);
+        if (cached) table->Store(key, value, settings.rolloutPlies);
+        leaf.reward += value;
+    }
+
+    return true;
+}
+
+double SearchWorker::Rollouts(const SearchNode& node, const vector<BlockType>& queue, int count, int plies,
+                              uint64_t seed)
+{
+    double total = 0;
+    for (int i = 0; i < count; ++i)
+        total += Rollout(node, queue, plies, SplitMix64(seed + uint64_t(i)));
+    return count > 0 ? total / count : 0;
+}
+
+double SearchWorker::Rollout(const SearchNode& node, const vector<BlockType>& queue, int plies, uint64_t seed)
+{
+    Board current = node.board, best;
+    GameStats currentStats = node.stats, bestStats;
+
+    array<BlockType, BAG_SIZE> bag = {{ I, J, L, O, S, T, Z }};
+    int dealt = BAG_SIZE;
+    int next = node.next;
+    BlockType piece = node.current;
+
+    auto draw = [&]()
+    {
+        if (next < int(queue.size())) return queue[next++];
+
+        if (dealt == BAG_SIZE)
+        {
+            for (int i = BAG_SIZE - 1; i > 0; --i)
+            {
+                seed = SplitMix64(seed);
+                swap(bag[i], bag[seed % (i + 1)]);
+            }
+            dealt = 0;
+        }
+        return bag[dealt++];
+    };
+
+    if (piece == EMPTY) piece = draw();
+
+    double value = 0;
+    for (int ply = 0; ply < plies; ++ply)
+    {
+        double bestReward = -numeric_limits<double>::infinity();
+        board = current;
+        stats = currentStats;
+        CacheHeuristics();
+
+        auto onPlacement = [&](const Placement& placement)
+        {
+            // Same top out rule as Expand
+            for (size_t i = 0; i < BOARD_WIDTH; ++i)
+                if (board.GetCell(i, 2) != EMPTY) return;
+
+            counters.evaluations++;
+
+            const double reward = CalcReward(piece, placement);
+            if (reward > bestReward)
+            {
+                bestReward = reward;
+                best = board;
+                bestStats = stats;
+            }
+            stats = currentStats;
+        };
+
+        counters.nodes++;
+        VisitPlacements(piece, board, onPlacement);
+
+        if (bestReward == -numeric_limits<double>::infinity()) return value + TOP_OUT_REWARD;
+
+        value += bestReward;
+        current = best;
+        currentStats = bestStats;
+        piece = draw();
+    }
+
+    return value;
+}
+
+void SearchWorker::RecordBest(SearchResult& result)
+{
+    const SearchNode& best = *max_element(beam.begin(), beam.end(),
+        [](const SearchNode& a, const SearchNode& b) { return a.reward < b.reward; });
+
+    result.found = true;
+    result.useHold = best.firstHold;
+    result.placement = best.firstPlacement;
+    result.reward = best.reward;
+    result.depth = best.depth;
+}
+
+bool SearchWorker::TimeUp()
+{
+    if (deadline == chrono::steady_clock::time_point::max()) return false;
+
+    interrupted = interrupted || chrono::steady_clock::now() >= deadline;
+    return interrupted;
+}
+
+double SearchWorker::Expectimax(const SearchNode& node, const vector<BlockType>& queue, int plies, int branch,
+                                unsigned drawn, size_t level)
+{
+    constexpr unsigned FULL_BAG = (1u << BAG_SIZE) - 1;
+
+    if (plies == 0) return 0;
+
+    // Chance node, averaged over what is left of the bag
+    if (node.current == EMPTY)
+    {
+        if (drawn == FULL_BAG) drawn = 0;
+
+        SearchNode dealt = node;
+        double total = 0;
+        int outcomes = 0;
+
+        for (int type = 0; type < BLOCK_TYPES; ++type)
+        {
+            if (drawn & (1u << type)) continue;
+
+            dealt.current = BlockType(type);
+            total += Expectimax(dealt, queue, plies, branch, drawn | (1u << type), level);
+            outcomes++;
+
+            if (interrupted) return 0;
+        }
+
+        return total / outcomes;
+    }
+
+    // Subtrees already searched to the same depth, from this or an earlier piece
+    uint64_t key = 0;
+    if (table)
+    {
+        key = NodeKey(node, queue, SplitMix64(EXPECTIMAX_SALT ^ uint64_t(branch) ^ uint64_t(drawn) << 16));
+        TTResult cached;
+
+        counters.tableProbes++;
+        if (table->Probe(key, cached) && cached.depth == plies)
+        {
+            counters.tableHits++;
+            return cached.value;
+        }
+    }
+
+    if (TimeUp()) return 0;
+
+    // Levels are sized up front, deeper calls must not move this one
+    vector<SearchNode>& moves = levels[level];
+    moves.clear();
+
+    auto visit = [&](const SearchNode& child) { moves.push_back(child); };
+    Expand(node, queue, visit);
+
+    if (moves.empty()) return TOP_OUT_REWARD;
+
+    const size_t searched = min(moves.size(), size_t(branch));
+    partial_sort(moves.begin(), moves.begin() + searched, moves.end(),
+        [](const SearchNode& a, const SearchNode& b) { return a.reward > b.reward; });
+
+    double best = moves[0].reward - node.reward;
+    size_t bestIndex = 0;
+
+    if (plies > 1)
+    {
+        PromoteTSpins(node, queue, moves, searched);
+        counters.cutoffs += moves.size() - searched;
+
+        best = -numeric_limits<double>::infinity();
+        for (size_t i = 0; i < searched; ++i)
+        {
+            const double value = moves[i].reward - node.reward
+                + Expectimax(moves[i], queue, plies - 1, branch, drawn, level + 1);
+            if (interrupted) return 0;
+
+            if (value > best)
+            {
+                best = value;
+                bestIndex = i;
+            }
+        }
+    }
+
+    if (table) table->Store(key, best, plies, moves[bestIndex].lastHold, moves[bestIndex].lastPlacement);
+    return best;
+}
+
+void SearchWorker::PromoteTSpins(const SearchNode& node, const vector<BlockType>& queue, vector<SearchNode>& moves,
+                                 size_t count)
+{
+    const BlockType held = (node.hold != EMPTY) ? node.hold
+        : (node.next < int(queue.size())) ? queue[node.next] : EMPTY;
+    if (count >= moves.size() || (node.current != T && held != T)) return;
+
+    const TSlots slots = FindTSpinSlots(BuildRowMasks(node.board));
+    if (slots.count == 0) return;
+
+    // The best move stays where it is
+    size_t last = count;
+    for (size_t i = count; i < moves.size() && last > 1; ++i)
+    {
+        const Placement& move = moves[i].lastPlacement;
+        if ((moves[i].lastHold ? held : node.current) != T) continue;
+
+        for (int j = 0; j < slots.count; ++j)
+        {
+            const Placement& slot = slots.items[j].placement;
+            if (move.rotation == slot.rotation && move.posX == slot.posX && move.posY == slot.posY)
+            {
+                swap(moves[--last], moves[i]);
+                break;
+            }
+        }
+    }
+}
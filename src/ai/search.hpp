@@ -0,0 +1,243 @@
+#ifndef SEARCH_HPP
+#define SEARCH_HPP
+
+#include <chrono>
+#include <limits>
+#include <vector>
+#include "batcheval.hpp"
+#include "env.hpp"
+#include "movegen.hpp"
+#include "tspin.hpp"
+#include "transposition.hpp"
+
+// Value of a line where the next piece no longer fits
+constexpr double TOP_OUT_REWARD = -1e5;
+
+/* A position somewhere down the search tree, detached from any game so it
+ * can be copied around and expanded on its own.
+ */
+struct SearchNode
+{
+    Board board;
+    GameStats stats;
+    BlockType current = EMPTY;
+    BlockType hold = EMPTY;
+    int next = 0;          // queue index of the piece after the current one
+    int depth = 0;         // pieces placed since the root
+    double reward = 0;     // rewards summed along the path
+
+    // Root move leading here, and the move from the parent
+    bool firstHold = false;
+    Placement firstPlacement = { INITIAL, 0, 0 };
+    bool lastHold = false;
+    Placement lastPlacement = { INITIAL, 0, 0 };
+};
+
+struct BeamSettings
+{
+    int width = 0;
+    int depth = 0;
+    int chancePlies = 0;    // expectimax plies past the leaves
+    int chanceBranch = 0;
+    int rollouts = 0;       // greedy playouts averaged at each leaf
+    int rolloutPlies = 0;
+    int variant = 0;        // helper threads search slightly different beams
+    int variants = 1;
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::time_point::max();
+};
+
+/* What one decision cost, or many added up. Kept by each worker for its
+ * own expansions, and summed over the workers by TetrisHeurAI.
+ */
+struct SearchStats
+{
+    int decisions = 0;
+    uint64_t nodes = 0;         // positions expanded
+    uint64_t evaluations = 0;   // children scored by CalcReward
+    uint64_t tableProbes = 0;
+    uint64_t tableHits = 0;
+    uint64_t cutoffs = 0;       // children dropped unsearched: beam, table, branch limits and pruning
+    int depth = 0;              // deepest tree ply expanded, summed over the decisions
+    chrono::duration<double> time = chrono::duration<double>::zero();
+
+    // Sums every counter, for the stats of several decisions
+    SearchStats& operator+=(const SearchStats& other);
+
+    double NodesPerSecond() const { return time.count() > 0 ? nodes / time.count() : 0; }
+    double HitRate() const { return tableProbes ? double(tableHits) / tableProbes : 0; }
+    double AverageDepth() const { return decisions ? double(depth) / decisions : 0; }
+
+    // Children dropped per child scored, so 1 drops as many as the search looked at
+    double CutoffRate() const { return evaluations ? double(cutoffs) / evaluations : 0; }
+
+    // b such that b^depth children would have been scored, per decision at the average depth
+    double BranchingFactor() const;
+};
+
+// How far past the beam the rewards of a result go, later stages add to them
+enum SearchStage { BEAM_STAGE, EXPECTIMAX_STAGE, ROLLOUT_STAGE };
+
+struct SearchResult
+{
+    bool found = false;
+    bool useHold = false;
+    Placement placement = { INITIAL, 0, 0 };
+    double reward = -numeric_limits<double>::infinity();
+    int depth = 0;          // deepest finished ply
+    SearchStage stage = BEAM_STAGE;
+    SearchStats stats;      // of the whole decision, filled in by TetrisHeurAI
+};
+
+/* Evaluates search nodes with the TetrisEnv reward, loading each node into
+ * its own board and stats before expanding it.
+ */
+class SearchWorker : public TetrisEnv
+{
+public:
+    SearchWorker() {};
+
+    void Configure(const HeuristicsWeights& weights, const MovementModel& movement);
+    void SetTable(TranspositionTable* table);
+
+    // Counted since the last reset, by this worker alone
+    SearchStats& Stats();
+    void ResetStats();
+
+    // Hash of everything the rest of the search depends on, board and queue left
+    uint64_t NodeKey(const SearchNode& node, const vector<BlockType>& queue, uint64_t salt);
+
+    /* Calls visit(child) for every placement of the current piece, then of
+     * the held one. The children of a piece share one batch, so visit must
+     * not expand on this worker again.
+     */
+    template <typename Visitor>
+    void Expand(const SearchNode& node, const vector<BlockType>& queue, Visitor& visit);
+
+    // Best path reward one piece below the node, hold included
+    double BestChildReward(const SearchNode& node, const vector<BlockType>& queue);
+
+    /* Keeps the best nodes of each depth and expands only those, down to
+     * depth pieces of the queue. The beam narrows with depth (width / ply),
+     * so a decision costs about width * log(depth) expansions.
+     *
+     * Since the width of a ply does not depend on the final depth, every
+     * finished ply is the answer of a shallower search. Past the deadline the
+     * search stops and returns false, leaving the deepest finished answer.
+     */
+    bool BeamSearch(const SearchNode& root, const vector<BlockType>& queue, const BeamSettings& settings,
+                    SearchResult& result);
+
+    /* Best expected reward of the next plies pieces after the node. Past the
+     * queue the next piece is unknown, but GenerateBag only appends whole
+     * 7-bags, so it is one of the pieces the fresh bag has not dealt yet,
+     * each as likely. Only the chanceBranch best moves of each piece are
+     * searched deeper.
+     */
+    double Expectimax(const SearchNode& node, const vector<BlockType>& queue, int plies, int branch,
+                      unsigned drawn=0, size_t level=0);
+
+    /* Average of count greedy playouts of plies pieces from the node, each
+     * piece hard dropped where CalcReward likes it best, without hold. The
+     * queue comes first, then fresh 7-bags drawn from the seed, so nodes
+     * given the same seed see the same futures and compare fairly. A
+     * playout that tops out ends there with TOP_OUT_REWARD, which weighs in
+     * as the share of playouts that did not survive.
+     */
+    double Rollouts(const SearchNode& node, const vector<BlockType>& queue, int count, int plies, uint64_t seed);
+
+    /* Brings moves that spin a T into a ready slot of the node (tspin.hpp)
+     * up among the first count, in place of the weakest, so a search that
+     * only follows its best few moves never cuts the T-spin off.
+     */
+    void PromoteTSpins(const SearchNode& node, const vector<BlockType>& queue, vector<SearchNode>& moves,
+                       size_t count);
+
+protected:
+    MovementModel movement;
+    TranspositionTable* table = nullptr;
+    SearchStats counters;
+    vector<SearchNode> beam, children;
+    vector<vector<SearchNode>> levels;
+    BoardBatch batch;
+    BatchHeuristics batchFeatures;
+    vector<SearchNode> batched;
+
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::time_point::max();
+    bool interrupted = false;
+
+    void RecordBest(SearchResult& result);
+    bool TimeUp();
+    bool RolloutLeaves(const SearchNode& root, const vector<BlockType>& queue, const BeamSettings& settings);
+    double Rollout(const SearchNode& node, const vector<BlockType>& queue, int plies, uint64_t seed);
+};
+
+template <typename Visitor>
+void SearchWorker::Expand(const SearchNode& node, const vector<BlockType>& queue, Visitor& visit)
+{
+    if (node.current == EMPTY) return;
+
+    counters.nodes++;
+    counters.depth = max(counters.depth, node.depth + 1);
+
+    auto pieceAt = [&](int i) { return i < int(queue.size()) ? queue[i] : EMPTY; };
+
+    // Every placement of the piece is locked in and scored first, then all are measured as one batch
+    auto placeAll = [&](BlockType piece, BlockType current, BlockType hold, int next, bool usedHold)
+    {
+        board = node.board;
+        stats = node.stats;
+        const ColumnMasks cols = BuildColumnMasks(board);
+
+        batch.Clear();
+        batched.clear();
+
+        auto onPlacement = [&](const Placement& placement)
+        {
+            // Same top out rule as TetrisCore::UpdateBoard
+            for (size_t i = 0; i < BOARD_WIDTH; ++i)
+                if (board.GetCell(i, 2) != EMPTY) return;
+
+            counters.evaluations++;
+
+            const int tSpinLines = (weights.tSpinSetup != 0) ? CountTSpinSlotLines(BuildRowMasks(board)) : 0;
+            batch.Add(cols, piece, placement, CalcScore(placement.spin), tSpinLines);
+
+            SearchNode& child = batched.emplace_back();
+            child.board = board;
+            child.stats = stats;
+            child.current = current;
+            child.hold = hold;
+            child.next = next;
+            child.depth = node.depth + 1;
+            child.firstHold = node.depth == 0 ? usedHold : node.firstHold;
+            child.firstPlacement = node.depth == 0 ? placement : node.firstPlacement;
+            child.lastHold = usedHold;
+            child.lastPlacement = placement;
+
+            stats = node.stats;
+        };
+
+        VisitMoves(piece, board, onPlacement, movement);
+        MeasureBatch(batch, batchFeatures);
+
+        for (int i = 0; i < batch.count; ++i)
+        {
+            SearchNode& child = batched[i];
+            BoardHeuristics features = batchFeatures.At(batch, i);
+            if (weights.contour != 0) features.contourFit = ContourFit(batchFeatures.contourIndex[i]);
+
+            child.reward = node.reward + WeighHeuristics(features, batch.scores[i]);
+            visit(child);
+        }
+    };
+
+    placeAll(node.current, pieceAt(node.next), node.hold, node.next + 1, false);
+
+    // Holding into an empty slot brings the next piece in right away
+    if (node.hold == EMPTY && pieceAt(node.next) != EMPTY)
+        placeAll(pieceAt(node.next), pieceAt(node.next + 1), node.current, node.next + 2, true);
+    else if (node.hold != EMPTY && node.hold != node.current)
+        placeAll(node.hold, pieceAt(node.next), node.current, node.next + 1, true);
+}
+
+#endif /* SEARCH_HPP */
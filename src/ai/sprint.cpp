@@ -0,0 +1,151 @@
+#include "sprint.hpp"
+
+TetrisSprintAI::TetrisSprintAI()
+{
+    weights = SprintWeights();
+    pondering = false;
+}
+
+// A ponder still running would call FindBestMove on a half destroyed object
+TetrisSprintAI::~TetrisSprintAI()
+{
+    StopPondering();
+}
+
+void TetrisSprintAI::Update()
+{
+    const int dropped = stats.droppedBlockCount;
+    TetrisHeurAI::Update();
+
+    // Counted for moves played, searches that were dropped never cost a key
+    if (stats.droppedBlockCount > dropped) report.keys += InputCost(playedType, playedPlacement, playedHold);
+
+    report.pieces = stats.droppedBlockCount;
+    report.lines = stats.clearedLineCount;
+
+    if (!gameOver && stats.clearedLineCount >= SPRINT_LINES)
+    {
+        gameOver = true;
+        report.finished = true;
+    }
+}
+
+void TetrisSprintAI::NewGame()
+{
+    TetrisHeurAI::NewGame();
+    report = SprintReport();
+}
+
+const SprintReport& TetrisSprintAI::GetReport() const
+{
+    return report;
+}
+
+// Survival weights that no longer chase points, line clears come at no bonus
+HeuristicsWeights TetrisSprintAI::SprintWeights()
+{
+    HeuristicsWeights sprint;
+    sprint.holeCount = -4;
+    sprint.aggrHeight = -0.5;
+    sprint.maxHeight = -0.5;
+    sprint.bumpiness = -0.5;
+    sprint.rowTransition = -0.5;
+    sprint.colTransition = -1;
+    sprint.multiWell = -0.5;
+    sprint.wellDepth = 0.3;
+    sprint.gameScore = 0;
+    return sprint;
+}
+
+int TetrisSprintAI::InputCost(BlockType type, const Placement& placement, bool useHold)
+{
+    const auto& minos = blockData[type][placement.rotation];
+    int minCol = BOARD_WIDTH, maxCol = 0;
+    for (const Coord& mino : minos)
+    {
+        minCol = min(minCol, mino.x);
+        maxCol = max(maxCol, mino.x);
+    }
+
+    // Rotated at spawn, then shifted: DAS into the wall and tapped back when that is shorter
+    const int spawnX = (type == O) ? 4 : 3;
+    const int shift = placement.posX - spawnX;
+    const int fromWall = (shift < 0) ? placement.posX + minCol : BOARD_WIDTH - 1 - (placement.posX + maxCol);
+    const int shiftKeys = (shift == 0) ? 0 : min(abs(shift), 1 + fromWall);
+
+    return int(useHold) + int(placement.rotation != INITIAL) + shiftKeys + 1;
+}
+
+bool TetrisSprintAI::FindBestMove(const SearchNode& root, const vector<BlockType>& queue, bool& useHold,
+                                  Placement& bestPlacement)
+{
+    auto better = [](const SearchNode& a, const SearchNode& b) { return a.reward > b.reward; };
+    auto finished = [](const SearchNode& node) { return node.stats.clearedLineCount >= SPRINT_LINES; };
+
+    const size_t width = (beamWidth > 0) ? beamWidth : SPRINT_BEAM_WIDTH;
+    const int depth = (beamDepth > 0) ? min(beamDepth, int(queue.size()) + 1) : int(queue.size()) + 1;
+
+    worker.Configure(weights, movement);
+    beam.assign(1, root);
+
+    auto keep = [&](const SearchNode& node)
+    {
+        if (children.size() < width)
+        {
+            children.push_back(node);
+            push_heap(children.begin(), children.end(), better);
+            return;
+        }
+
+        worker.Stats().cutoffs++;
+        if (node.reward > children.front().reward)
+        {
+            pop_heap(children.begin(), children.end(), better);
+            children.back() = node;
+            push_heap(children.begin(), children.end(), better);
+        }
+    };
+
+    for (int ply = 0; ply < depth; ++ply)
+    {
+        children.clear();
+
+        for (const SearchNode& node : beam)
+        {
+            // Finished lines wait for the others with what they scored
+            if (finished(node))
+            {
+                keep(node);
+                continue;
+            }
+
+            const BlockType held = (node.hold != EMPTY) ? node.hold
+                : (node.next < int(queue.size())) ? queue[node.next] : EMPTY;
+
+            auto visit = [&](const SearchNode& child)
+            {
+                SearchNode scored = child;
+                const BlockType placed = child.lastHold ? held : node.current;
+                scored.reward -= SPRINT_KEY_COST * InputCost(placed, child.lastPlacement, child.lastHold);
+
+                if (finished(scored))
+                    scored.reward += SPRINT_FINISH_REWARD - SPRINT_PIECE_COST * scored.depth;
+                keep(scored);
+            };
+
+            worker.Expand(node, queue, visit);
+        }
+
+        if (children.empty()) break;
+        swap(beam, children);
+    }
+
+    if (beam.front().depth == 0) return false;
+
+    const SearchNode& best = *max_element(beam.begin(), beam.end(),
+        [](const SearchNode& a, const SearchNode& b) { return a.reward < b.reward; });
+
+    useHold = best.firstHold;
+    bestPlacement = best.firstPlacement;
+    return true;
+}
@@ -0,0 +1,61 @@
+#ifndef SPRINT_HPP
+#define SPRINT_HPP
+
+#include "heuristics.hpp"
+
+constexpr int SPRINT_LINES = 40;                // TetrisUI's LINES mode
+constexpr int SPRINT_BEAM_WIDTH = 64;           // unless SetBeamSearch asks for another
+constexpr double SPRINT_KEY_COST = 0.5;         // reward given up per keypress
+constexpr double SPRINT_FINISH_REWARD = 1e6;
+constexpr double SPRINT_PIECE_COST = 1e3;       // per piece, for lines that reach SPRINT_LINES
+
+struct SprintReport
+{
+    int pieces = 0;
+    int keys = 0;
+    int lines = 0;
+    bool finished = false;
+
+    // Time of the run played at a steady pps, no matter how long the search took
+    double TheoreticalTime(float pps) const { return pps > 0 ? pieces / pps : 0; }
+    double KeysPerPiece() const { return pieces > 0 ? double(keys) / pieces : 0; }
+};
+
+/* Plays TetrisUI's 40 lines mode for the fewest pieces and keypresses.
+ *
+ * Every piece brings 4 cells and every line takes 10, so a run takes 100
+ * pieces plus a quarter of the cells still on the board when line 40
+ * clears. The planner keeps a flat, clean stack with survival weights
+ * minus the game score, and charges each placement the keys a finesse
+ * player would press for it. Once line 40 is within the preview, the
+ * lines finishing in the fewest pieces win outright.
+ *
+ * Only hard drops are keyed, at DAS to the walls, single taps, one press
+ * per rotation (180 included) and one for hold, counted by Update as each
+ * move is played, so a search pondered in the background never adds keys.
+ */
+class TetrisSprintAI : public TetrisHeurAI
+{
+public:
+    TetrisSprintAI();
+    ~TetrisSprintAI() override;
+
+    // TetrisHeurAI::Update, ending the game at SPRINT_LINES like TetrisUI
+    void Update() override;
+    void NewGame() override;
+
+    const SprintReport& GetReport() const;
+
+    static int InputCost(BlockType type, const Placement& placement, bool useHold);
+    static HeuristicsWeights SprintWeights();
+
+protected:
+    bool FindBestMove(const SearchNode& root, const vector<BlockType>& queue, bool& useHold,
+                      Placement& bestPlacement) override;
+
+private:
+    SprintReport report;
+    vector<SearchNode> beam, children;
+};
+
+#endif /* SPRINT_HPP */
@@ -0,0 +1,69 @@
+#include "threadpool.hpp"
+
+ThreadPool::ThreadPool(int threads)
+{
+    for (int i = 1; i < threads; ++i)
+        this->threads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (thread& worker : threads)
+        worker.join();
+}
+
+int ThreadPool::Size() const
+{
+    return int(threads.size()) + 1;
+}
+
+void ThreadPool::Run(int tasks, const function<void(int, int)>& job)
+{
+    {
+        lock_guard<mutex> guard(lock);
+        this->job = &job;
+        taskCount = tasks;
+        nextTask = 0;
+        busy = int(threads.size());
+        round++;
+    }
+    wake.notify_all();
+
+    Drain(0);
+
+    unique_lock<mutex> guard(lock);
+    done.wait(guard, [&] { return busy == 0; });
+    this->job = nullptr;
+}
+
+void ThreadPool::WorkerLoop(int index)
+{
+    unsigned seen = 0;
+
+    while (true)
+    {
+        {
+            unique_lock<mutex> guard(lock);
+            wake.wait(guard, [&] { return stopping || round != seen; });
+            if (stopping) return;
+            seen = round;
+        }
+
+        Drain(index);
+
+        lock_guard<mutex> guard(lock);
+        if (--busy == 0) done.notify_all();
+    }
+}
+
+void ThreadPool::Drain(int thread)
+{
+    for (int task = nextTask++; task < taskCount; task = nextTask++)
+        (*job)(task, thread);
+}
@@ -0,0 +1,48 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/* Fixed set of threads that take tasks off a shared counter. The thread
+ * calling Run works too and counts as thread 0, so a pool of n threads
+ * starts n - 1 of its own.
+ */
+class ThreadPool
+{
+public:
+    explicit ThreadPool(int threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int Size() const;
+
+    // Calls job(task, thread) once for every task and returns when all are done
+    void Run(int tasks, const function<void(int, int)>& job);
+
+private:
+    vector<thread> threads;
+    mutex lock;
+    condition_variable wake;
+    condition_variable done;
+
+    const function<void(int, int)>* job = nullptr;
+    int taskCount = 0;
+    atomic<int> nextTask = 0;
+    int busy = 0;
+    unsigned round = 0;
+    bool stopping = false;
+
+    void WorkerLoop(int index);
+    void Drain(int thread);
+};
+
+#endif /* THREADPOOL_HPP */
@@ -0,0 +1,179 @@
+#include <bit>
+#include <new>
+#include "transposition.hpp"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// Packed data word: value as a float, then the move, depth and generation
+constexpr int TT_MOVE_SHIFT = 32;
+constexpr uint32_t TT_MOVE_MASK = (1u << 14) - 1;
+constexpr int TT_DEPTH_SHIFT = 46;
+constexpr int TT_GENERATION_SHIFT = 51;
+
+uint32_t PackMove(bool useHold, const Placement& move)
+{
+    return uint32_t(useHold)
+        | uint32_t(move.rotation) << 1
+        | uint32_t(move.posX + MOVEGEN_OFFSET) << 3
+        | uint32_t(move.posY + MOVEGEN_OFFSET) << 7
+        | uint32_t(move.spin) << 12;
+}
+
+void UnpackMove(uint32_t bits, bool& useHold, Placement& move)
+{
+    useHold = bits & 1;
+    move.rotation = RotateState((bits >> 1) & 3);
+    move.posX = int((bits >> 3) & 15) - MOVEGEN_OFFSET;
+    move.posY = int((bits >> 7) & 31) - MOVEGEN_OFFSET;
+    move.spin = SpinType((bits >> 12) & 3);
+}
+
+TranspositionTable::TranspositionTable(size_t megabytes, bool hugePages)
+{
+    Resize(megabytes, hugePages);
+}
+
+TranspositionTable::~TranspositionTable()
+{
+    Release();
+}
+
+void TranspositionTable::Resize(size_t megabytes, bool hugePages)
+{
+    Release();
+    if (megabytes == 0) return;
+
+    bucketCount = bit_floor(megabytes * 1024 * 1024 / sizeof(Bucket));
+    allocatedBytes = bucketCount * sizeof(Bucket);
+    void* memory = nullptr;
+
+#ifdef __linux__
+    if (hugePages)
+    {
+        constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+        allocatedBytes = (allocatedBytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+
+        memory = mmap(nullptr, allocatedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) memory = nullptr;
+        else
+        {
+            madvise(memory, allocatedBytes, MADV_HUGEPAGE);
+            mapped = true;
+        }
+    }
+#endif
+
+    if (!memory) memory = ::operator new(allocatedBytes, align_val_t(alignof(Bucket)));
+
+    buckets = new (memory) Bucket[bucketCount]();
+    generation = 0;
+}
+
+void TranspositionTable::Release()
+{
+    if (!buckets) return;
+
+#ifdef __linux__
+    if (mapped) munmap(buckets, allocatedBytes);
+    else ::operator delete(buckets, align_val_t(alignof(Bucket)));
+#else
+    ::operator delete(buckets, align_val_t(alignof(Bucket)));
+#endif
+
+    buckets = nullptr;
+    bucketCount = 0;
+    allocatedBytes = 0;
+    mapped = false;
+}
+
+// Not safe to run alongside a search
+void TranspositionTable::Clear()
+{
+    for (size_t i = 0; i < bucketCount; ++i)
+        for (Entry& entry : buckets[i].entries)
+        {
+            entry.check.store(0, memory_order_relaxed);
+            entry.data.store(0, memory_order_relaxed);
+        }
+    generation = 0;
+}
+
+// Results of older searches stay valid but are the first to be replaced
+void TranspositionTable::NewSearch()
+{
+    generation++;
+}
+
+size_t TranspositionTable::Size() const
+{
+    return bucketCount;
+}
+
+bool TranspositionTable::Probe(uint64_t key, TTResult& result) const
+{
+    if (!buckets) return false;
+
+    const Bucket& bucket = buckets[key & (bucketCount - 1)];
+    for (const Entry& entry : bucket.entries)
+    {
+        const uint64_t data = entry.data.load(memory_order_relaxed);
+        if ((entry.check.load(memory_order_relaxed) ^ data) != key) continue;
+
+        Unpack(data, result);
+        result.current = GenerationOf(data) == generation;
+        return true;
+    }
+
+    return false;
+}
+
+void TranspositionTable::Store(uint64_t key, double value, int depth, bool useHold, const Placement& move)
+{
+    if (!buckets) return;
+
+    Bucket& bucket = buckets[key & (bucketCount - 1)];
+    const uint64_t data = Pack(value, depth, generation, useHold, move);
+
+    Entry* slot = nullptr;
+    for (Entry& entry : bucket.entries)
+        if ((entry.check.load(memory_order_relaxed) ^ entry.data.load(memory_order_relaxed)) == key)
+            slot = &entry;
+
+    // Depth preferred slot, taken over when stale or not as deep, else the second one
+    if (!slot)
+    {
+        const uint64_t kept = bucket.entries[0].data.load(memory_order_relaxed);
+        const bool replaceFirst = GenerationOf(kept) != generation || depth >= DepthOf(kept);
+        slot = &bucket.entries[replaceFirst ? 0 : 1];
+    }
+
+    slot->check.store(key ^ data, memory_order_relaxed);
+    slot->data.store(data, memory_order_relaxed);
+}
+
+uint64_t TranspositionTable::Pack(double value, int depth, uint8_t generation, bool useHold, const Placement& move)
+{
+    return uint64_t(bit_cast<uint32_t>(float(value)))
+        | uint64_t(PackMove(useHold, move)) << TT_MOVE_SHIFT
+        | uint64_t(clamp(depth, 0, TT_MAX_DEPTH)) << TT_DEPTH_SHIFT
+        | uint64_t(generation) << TT_GENERATION_SHIFT;
+}
+
+void TranspositionTable::Unpack(uint64_t data, TTResult& result)
+{
+    result.value = bit_cast<float>(uint32_t(data));
+    result.depth = DepthOf(data);
+    UnpackMove(uint32_t(data >> TT_MOVE_SHIFT) & TT_MOVE_MASK, result.useHold, result.move);
+}
+
+uint8_t TranspositionTable::GenerationOf(uint64_t data)
+{
+    return uint8_t(data >> TT_GENERATION_SHIFT);
+}
+
+int TranspositionTable::DepthOf(uint64_t data)
+{
+    return int((data >> TT_DEPTH_SHIFT) & TT_MAX_DEPTH);
+}
@@ -0,0 +1,94 @@
+#ifndef TRANSPOSITION_HPP
+#define TRANSPOSITION_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "movegen.hpp"
+
+constexpr size_t TT_DEFAULT_MB = 16;
+constexpr int TT_MAX_DEPTH = 31;    // deeper results are stored as this depth
+
+constexpr uint64_t SplitMix64(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+inline uint64_t HashColumns(const ColumnMasks& cols)
+{
+    uint64_t hash = 0;
+    for (size_t i = 0; i < BOARD_WIDTH; ++i)
+        hash = SplitMix64(hash ^ cols[i]);
+    return hash;
+}
+
+// Move in 14 bits: hold, rotation, origin and spin, as stored by the table and the opening book
+uint32_t PackMove(bool useHold, const Placement& move);
+void UnpackMove(uint32_t bits, bool& useHold, Placement& move);
+
+struct TTResult
+{
+    double value;
+    int depth;
+    bool current;   // written during the running search
+    bool useHold;
+    Placement move;
+};
+
+/* Fixed-size table of search results shared by every thread of a search.
+ * Each entry is two 64-bit words written without locks, the key stored
+ * xored with the data so that a torn write reads back as a miss.
+ *
+ * Buckets hold two entries. The first keeps the deepest result of the
+ * running search, the second is always overwritten.
+ */
+class TranspositionTable
+{
+public:
+    TranspositionTable() {};
+    explicit TranspositionTable(size_t megabytes, bool hugePages=false);
+    ~TranspositionTable();
+
+    TranspositionTable(const TranspositionTable&) = delete;
+    TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+    // Huge pages are only asked for on Linux, elsewhere the flag is ignored
+    void Resize(size_t megabytes, bool hugePages=false);
+    void Clear();
+    void NewSearch();
+
+    size_t Size() const;
+    bool Probe(uint64_t key, TTResult& result) const;
+    void Store(uint64_t key, double value, int depth, bool useHold=false,
+               const Placement& move={ INITIAL, 0, 0 });
+
+private:
+    struct Entry
+    {
+        atomic<uint64_t> check;   // key ^ data
+        atomic<uint64_t> data;
+    };
+
+    struct alignas(2 * sizeof(Entry)) Bucket
+    {
+        Entry entries[2];
+    };
+
+    Bucket* buckets = nullptr;
+    size_t bucketCount = 0;
+    size_t allocatedBytes = 0;
+    bool mapped = false;
+    uint8_t generation = 0;
+
+    void Release();
+
+    static uint64_t Pack(double value, int depth, uint8_t generation, bool useHold, const Placement& move);
+    static void Unpack(uint64_t data, TTResult& result);
+    static uint8_t GenerationOf(uint64_t data);
+    static int DepthOf(uint64_t data);
+};
+
+#endif /* TRANSPOSITION_HPP */
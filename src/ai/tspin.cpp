@@ -0,0 +1,48 @@
+#include "tspin.hpp"
+
+TSlots FindTSpinSlots(const RowMasks& rows)
+{
+    TSlots slots;
+
+    // Columns x - 1 to x + 1 of a row as three bits, the walls count as filled
+    auto window = [&](int row, int x)
+    {
+        const uint32_t walled = uint32_t(rows[row]) << 1 | 1u | 1u << (BOARD_WIDTH + 1);
+        return (walled >> x) & 7;
+    };
+    auto filled = [&](int row, int x) { return row >= BOARD_HEIGHT || (rows[row] >> x) & 1; };
+
+    // Row r is the bottom row of the slot, the rows above are never the spawn rows
+    for (int r = 4; r < BOARD_HEIGHT; ++r)
+    {
+        if (rows[r] == FULL_ROW) continue;
+
+        for (int x = 0; x < BOARD_WIDTH; ++x)
+        {
+            if (window(r, x) != 0b101 || !filled(r + 1, x)) continue;
+
+            const uint32_t middle = window(r - 1, x);
+            const uint32_t top = window(r - 2, x);
+
+            // Double: the T points down into the hole, one overhang covers a top corner
+            if (middle == 0b000 && (top == 0b001 || top == 0b100))
+                slots.items[slots.count++] = { { DOWN, x - 1, r - 2, T_SPIN }, 2 };
+
+            // Triple: a three deep well with a notch on one side, under an overhang
+            else if ((middle == 0b100 || middle == 0b001) && top == 0b101 && !filled(r - 3, x))
+                slots.items[slots.count++] = { { middle == 0b100 ? LEFT : RIGHT, x - 1, r - 2, T_SPIN }, 3 };
+        }
+    }
+
+    return slots;
+}
+
+int CountTSpinSlotLines(const RowMasks& rows)
+{
+    const TSlots slots = FindTSpinSlots(rows);
+
+    int lines = 0;
+    for (int i = 0; i < slots.count; ++i)
+        lines += slots.items[i].lines;
+    return lines;
+}
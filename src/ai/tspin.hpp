@@ -0,0 +1,38 @@
+#ifndef TSPIN_HPP
+#define TSPIN_HPP
+
+#include "kernels.hpp"
+
+// At most one slot per cell of the board
+constexpr int MAX_T_SLOTS = BOARD_WIDTH * BOARD_HEIGHT;
+
+// Where a T would spin in, and the rows it fills there
+struct TSlot
+{
+    Placement placement;
+    int lines;
+};
+
+struct TSlots
+{
+    array<TSlot, MAX_T_SLOTS> items;
+    int count = 0;
+};
+
+/* Finds T-spin double and triple slots: the cells a T would take are open,
+ * the cells around them are filled so it scores as a T-spin, and the
+ * overhang is in place. Only the slot itself is matched, the rest of its
+ * rows may still be open, so a slot counts from the moment it is built.
+ * Each pattern compares three-cell windows cut out of the row masks.
+ *
+ *   double     triple     (and mirrored)
+ *   X . .      X . X
+ *   . . .      . . X
+ *   X . X      X . X
+ */
+TSlots FindTSpinSlots(const RowMasks& rows);
+
+// Rows of all slots together, the T-spin setup feature of CalcReward
+int CountTSpinSlotLines(const RowMasks& rows);
+
+#endif /* TSPIN_HPP */
@@ -13,7 +13,7 @@ struct Coord
  * Indexed using enums (orders in enums and arrays are the same)
  */
 
-static const array<array<array<Coord, TETROMINO_SIZE>, ROTATION_STATES>, BLOCK_TYPES> blockData = {{
+static constexpr array<array<array<Coord, TETROMINO_SIZE>, ROTATION_STATES>, BLOCK_TYPES> blockData = {{
     {{ // I
         {{ {0, 1}, {1, 1}, {2, 1}, {3, 1} }}, // INITIAL
         {{ {1, 0}, {1, 1}, {1, 2}, {1, 3} }}, // LEFT
@@ -76,6 +76,11 @@ array<array<BlockType, BOARD_HEIGHT>, BOARD_WIDTH>& Board::GetBoard()
     return board;
 }
 
+const array<array<BlockType, BOARD_HEIGHT>, BOARD_WIDTH>& Board::GetBoard() const
+{
+    return board;
+}
+
 void Board::ClearRow(int row)
 {
     for (size_t i = 0; i < BOARD_WIDTH; ++i)
@@ -18,6 +18,7 @@ public:
     BlockType GetCell(int posX, int posY)                       const;
 
     array<array<BlockType, BOARD_HEIGHT>, BOARD_WIDTH>& GetBoard();
+    const array<array<BlockType, BOARD_HEIGHT>, BOARD_WIDTH>& GetBoard() const;
 
 private:
     array<array<BlockType, BOARD_HEIGHT>, BOARD_WIDTH> board;
@@ -11,12 +11,21 @@ constexpr int BOARD_HEIGHT = 22;
 
 constexpr int BAG_SIZE = 7;
 
+// Lock delay: moves allowed after touching down, and idle seconds before locking
+constexpr int LOCK_DOWN_MOVES = 15;
+constexpr float LOCK_DOWN_DELAY = 0.5;
+
+// Rows per frame, 20G drops a piece to the floor instantly
+constexpr float MAX_GRAVITY = 20.0;
+
 constexpr int BLOCK_TYPES = 7;
 enum BlockType {I, J, L, O, S, T, Z, EMPTY};
 
 constexpr int ROTATION_STATES = 4;
 enum RotateState {INITIAL, LEFT, DOWN, RIGHT};
 
+enum SpinType {NO_SPIN, T_SPIN_MINI, T_SPIN, ALL_SPIN};
+
 
 struct GameStats
 {
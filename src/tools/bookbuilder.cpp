@@ -0,0 +1,171 @@
+/* Builds the opening book TetrisHeurAI loads at startup.
+ *
+ *   BookBuilder <output> [games] [plies] [beam width] [threads] [gen_N.bin]
+ *
+ * Plays the first plies pieces of games random games from an empty board,
+ * each move picked by a wide beam search over only the BOOK_PREVIEW pieces
+ * a book key covers, so a position always gets the same move. Weights are
+ * the best individual of the given generation file, or the defaults, and
+ * the AI only plays from the book with the same weights.
+ */
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include "ai/openingbook.hpp"
+#include "ai/search.hpp"
+#include "ai/threadpool.hpp"
+
+constexpr int BUILDER_DEFAULT_GAMES = 1000;
+constexpr int BUILDER_DEFAULT_PLIES = BAG_SIZE;
+constexpr int BUILDER_DEFAULT_WIDTH = 1024;
+
+// Same layout as Trainer::SaveData, the lowest fitness is the best
+static bool LoadBestWeights(const string& path, HeuristicsWeights& weights)
+{
+    ifstream f(path, ios::binary);
+    if (!f.is_open()) return false;
+
+    int generation;
+    f.read(reinterpret_cast<char*>(&generation), sizeof(generation));
+
+    bool found = false;
+    double bestFitness = 0;
+
+    while (true)
+    {
+        HeuristicsWeights chromosome;
+        double fitness;
+
+        for (double* gene : chromosome.asArray())
+            f.read(reinterpret_cast<char*>(gene), sizeof(double));
+        f.read(reinterpret_cast<char*>(&fitness), sizeof(double));
+        if (!f) break;
+
+        if (!found || fitness < bestFitness)
+        {
+            weights = chromosome;
+            bestFitness = fitness;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+static void PlayGame(SearchWorker& worker, int seed, int plies, int width, vector<BookEntry>& entries)
+{
+    mt19937 rng(seed);
+    vector<BlockType> pieces;
+
+    auto addBag = [&]()
+    {
+        array<BlockType, BAG_SIZE> bag = {{ I, J, L, O, S, T, Z }};
+        shuffle(bag.begin(), bag.end(), rng);
+        pieces.insert(pieces.end(), bag.begin(), bag.end());
+    };
+
+    addBag();
+    SearchNode node;
+    node.board.Init();
+    node.current = pieces[0];
+    node.next = 1;
+
+    BeamSettings settings;
+    settings.width = width;
+    settings.depth = BOOK_PREVIEW + 1;
+
+    for (int ply = 0; ply < plies; ++ply)
+    {
+        while (int(pieces.size()) < node.next + BOOK_PREVIEW + 1) addBag();
+
+        // The search sees the book key and nothing more
+        const vector<BlockType> preview(pieces.begin() + node.next, pieces.begin() + node.next + BOOK_PREVIEW);
+        SearchNode root = node;
+        root.next = 0;
+        root.depth = 0;
+        root.reward = 0;
+
+        SearchResult result;
+        worker.BeamSearch(root, preview, settings, result);
+        if (!result.found) return;
+
+        entries.push_back({ BookKey(root, preview), PackMove(result.useHold, result.placement), 0 });
+
+        // Played on the full sequence, the next key sees the following pieces
+        bool played = false;
+        auto follow = [&](const SearchNode& child)
+        {
+            if (played || child.lastHold != result.useHold) return;
+
+            const Placement& move = child.lastPlacement;
+            if (move.rotation != result.placement.rotation || move.posX != result.placement.posX
+                || move.posY != result.placement.posY)
+                return;
+
+            node = child;
+            played = true;
+        };
+
+        worker.Expand(node, pieces, follow);
+        if (!played) return;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        cerr << "usage: " << argv[0] << " <output> [games] [plies] [beam width] [threads] [gen_N.bin]" << endl;
+        return 1;
+    }
+
+    const string output = argv[1];
+    const int games = (argc > 2) ? stoi(argv[2]) : BUILDER_DEFAULT_GAMES;
+    const int plies = (argc > 3) ? stoi(argv[3]) : BUILDER_DEFAULT_PLIES;
+    const int width = (argc > 4) ? stoi(argv[4]) : BUILDER_DEFAULT_WIDTH;
+    const int threadCount = (argc > 5) ? stoi(argv[5]) : max(int(thread::hardware_concurrency()), 1);
+
+    HeuristicsWeights weights;
+    if (argc > 6 && !LoadBestWeights(argv[6], weights))
+    {
+        cerr << "cannot read " << argv[6] << endl;
+        return 1;
+    }
+
+    ThreadPool pool(threadCount);
+    vector<unique_ptr<SearchWorker>> workers;
+    for (int i = 0; i < pool.Size(); ++i)
+    {
+        workers.push_back(make_unique<SearchWorker>());
+        workers.back()->Configure(weights, MovementModel());
+    }
+
+    vector<vector<BookEntry>> gameEntries(games);
+    atomic<int> done = 0;
+
+    pool.Run(games, [&](int task, int thread)
+    {
+        PlayGame(*workers[thread], task, plies, width, gameEntries[task]);
+        if (++done % 100 == 0) cout << done << "/" << games << " games" << endl;
+    });
+
+    // In game order, so the same arguments always write the same book
+    vector<BookEntry> entries;
+    unordered_map<uint64_t, uint32_t> seen;
+    for (const vector<BookEntry>& game : gameEntries)
+        for (const BookEntry& entry : game)
+            if (seen.emplace(entry.key, entry.move).second) entries.push_back(entry);
+
+    if (!OpeningBook::Write(output, entries, BookWeightsHash(weights)))
+    {
+        cerr << "cannot write " << output << endl;
+        return 1;
+    }
+
+    cout << entries.size() << " positions written to " << output << endl;
+    return 0;
+}
@@ -53,7 +53,11 @@ App::App()
     , fontSize(0.0)
     , currentPage(PLAY)
     , isMainStarted(false)
-{}
+    , evalAI(&tetrisAI)
+{
+    tetrisAI.LoadOpeningBook();
+    mctsAI.LoadOpeningBook();
+}
 
 void App::Loop()
 {
@@ -242,7 +246,7 @@ void App::CalculateElements()
         p2TextPos[i].SetY(tabBtn[0].GetY()
                           + tabBtn[0].GetHeight()
                           + fontSize * TITLE_FONT_SIZE_RATIO
-                          + canvas.GetHeight() * SLIDER_SPACING * i
+                          + canvas.GetHeight() * P2_SLIDER_SPACING * i
                           + horizontalPadding * 2);
 
         switch (i)
@@ -258,6 +262,14 @@ void App::CalculateElements()
             case GEN:
                 p2Slider.push_back(Slider(0.0, trainer.generation));
                 break;
+
+            case AI_GRAVITY:
+                p2Slider.push_back(Slider(0.0, 1.0));
+                break;
+
+            case SEARCH:
+                p2Slider.push_back(Slider(0.0, SEARCH_MODE_COUNT - 1));
+                break;
         }
 
         p2Slider[i].sliderBar.SetSize(
@@ -266,7 +278,7 @@ void App::CalculateElements()
         );
 
         p2Slider[i].sliderBar.SetPosition(
-            p2TextPos[i].GetX() + font.MeasureText(p2SliderString[REPEAT], fontSize, 1.0).GetX() + horizontalPadding,
+            p2TextPos[i].GetX() + font.MeasureText(p2SliderString[AI_GRAVITY], fontSize, 1.0).GetX() + horizontalPadding,
             p2TextPos[i].GetY() + (fontSize - canvas.GetHeight() * SLIDER_HEIGHT) / 4
         );
 
@@ -386,23 +398,34 @@ void App::EvalPage()
     static int repeatTimes = 0;
     static float sumClearedLines = 0.0;
     static float sumScore = 0.0;
+    static float sumPieces = 0.0;
 
     if (isMainStarted)
     {
-        tetrisAI.Update();
-        tetrisAI.Draw(
-            "Avg. Score",
-            format("{:.1f}", sumScore / runTimes),
-            format("  lines: {:.1f}", sumClearedLines / runTimes)
-        );
+        evalAI->Update();
+
+        // A sprint is scored by the pieces it took, not the points
+        if (evalAI == &sprintAI)
+            evalAI->Draw(
+                "Avg. Pieces",
+                format("{:.1f}", sumPieces / runTimes),
+                format("  lines: {:.1f}", sumClearedLines / runTimes)
+            );
+        else
+            evalAI->Draw(
+                "Avg. Score",
+                format("{:.1f}", sumScore / runTimes),
+                format("  lines: {:.1f}", sumClearedLines / runTimes)
+            );
 
-        if (tetrisAI.IsOver() && runTimes <= repeatTimes)
+        if (evalAI->IsOver() && runTimes <= repeatTimes)
         {
             runTimes++;
-            sumClearedLines += tetrisAI.stats.clearedLineCount;
-            sumScore += tetrisAI.stats.score;
+            sumClearedLines += evalAI->stats.clearedLineCount;
+            sumScore += evalAI->stats.score;
+            sumPieces += evalAI->stats.droppedBlockCount;
 
-            if (runTimes <= repeatTimes) tetrisAI.NewGame();
+            if (runTimes <= repeatTimes) evalAI->NewGame();
         }
 
         return;
@@ -426,6 +449,15 @@ void App::EvalPage()
                 else font.DrawText(format("{}", floor(val)), p2ValuePos[i], fontSize, 1.0, RAYWHITE);
                 break;
 
+            case AI_GRAVITY:
+                if (val == 0.0) font.DrawText("OFF", p2ValuePos[i], fontSize, 1.0, RAYWHITE);
+                else font.DrawText(format("{:.2f}", val), p2ValuePos[i], fontSize, 1.0, RAYWHITE);
+                break;
+
+            case SEARCH:
+                font.DrawText(searchModeString[lround(val)], p2ValuePos[i], fontSize, 1.0, RAYWHITE);
+                break;
+
             default:
                 font.DrawText(format("{}", floor(val)), p2ValuePos[i], fontSize, 1.0, RAYWHITE);
                 break;
@@ -455,16 +487,24 @@ void App::EvalPage()
         float pps = p2Slider[PPS].GetValue();
         repeatTimes = p2Slider[REPEAT].GetValue();
         int generation = p2Slider[GEN].GetValue();
+        SearchMode search = SearchMode(lround(p2Slider[SEARCH].GetValue()));
 
         sumClearedLines = 0.0;
         sumScore = 0.0;
+        sumPieces = 0.0;
         runTimes = 0;
 
         trainer.LoadGeneration(generation);
 
-        tetrisAI.SetPPS(pps == 20.0 ? 0 : pps);
-        tetrisAI.UpdateHeuristics(trainer.GetBestIndividual().chromosome);
-        tetrisAI.NewGame();
+        if (search == MCTS_SEARCH) evalAI = &mctsAI;
+        else if (search == SPRINT_SEARCH) evalAI = &sprintAI;
+        else evalAI = &tetrisAI;
+        tetrisAI.SetBeamSearch(search == BEAM_SEARCH ? EVAL_BEAM_WIDTH : 0);
+
+        evalAI->SetPPS(pps == 20.0 ? 0 : pps);
+        evalAI->SetGravity(p2Slider[AI_GRAVITY].GetValue());
+        if (search != SPRINT_SEARCH) evalAI->UpdateHeuristics(trainer.GetBestIndividual().chromosome);
+        evalAI->NewGame();
     }
 }
 
@@ -4,6 +4,8 @@
 #include "../include/raylib-cpp.hpp"
 #include "tetrisUI.hpp"
 #include "ai/genetic.hpp"
+#include "ai/mcts.hpp"
+#include "ai/sprint.hpp"
 #include <array>
 
 using namespace std;
@@ -19,9 +21,16 @@ enum P1Slider { ARR, DAS, SDF, GRAVITY };
 constexpr array<string, P1_SLIDER_COUNT> p1SliderString = {{ "ARR", "DAS", "SDF", "GRAVITY" }};
 constexpr array<string, BTN_COUNT> p1BtnString = {{ "40 LINES", "BLITZ", "ZEN" }};
 
-constexpr int P2_SLIDER_COUNT = 3;
-enum P2Slider { PPS, REPEAT, GEN };
-constexpr array<string, P2_SLIDER_COUNT> p2SliderString = {{ "PPS", "REPEAT", "GEN." }};
+constexpr int P2_SLIDER_COUNT = 5;
+enum P2Slider { PPS, REPEAT, GEN, AI_GRAVITY, SEARCH };
+constexpr array<string, P2_SLIDER_COUNT> p2SliderString = {{ "PPS", "REPEAT", "GEN.", "GRAVITY", "SEARCH" }};
+
+// Searches the EVAL page can run the AI with, picked on the SEARCH slider.
+// SPRINT plays 40 lines for the fewest pieces with its own weights
+constexpr int SEARCH_MODE_COUNT = 4;
+enum SearchMode { TWO_PIECE_SEARCH, BEAM_SEARCH, MCTS_SEARCH, SPRINT_SEARCH };
+constexpr array<string, SEARCH_MODE_COUNT> searchModeString = {{ "2 PIECE", "BEAM", "MCTS", "SPRINT" }};
+constexpr int EVAL_BEAM_WIDTH = 64;
 constexpr array<string, BTN_COUNT> p2BtnString = {{ "RUN GA", "CURRENT", "GEN. " }};
 
 constexpr int P3_SLIDER_COUNT = 1;
@@ -37,6 +46,7 @@ constexpr float TITLE_FONT_SIZE_RATIO = 1.5;
 constexpr float SLIDER_WIDTH = 0.42;
 constexpr float SLIDER_HEIGHT = 0.03;
 constexpr float SLIDER_SPACING = 0.15;
+constexpr float P2_SLIDER_SPACING = SLIDER_SPACING * P1_SLIDER_COUNT / P2_SLIDER_COUNT; // same height as PLAY
 constexpr float SLIDER_PADDING = 0.05;
 
 // External variables from main driver
@@ -106,6 +116,9 @@ private:
 
     TetrisUI tetrisGame;
     TetrisHeurAI tetrisAI;
+    TetrisMctsAI mctsAI;
+    TetrisSprintAI sprintAI;
+    TetrisHeurAI* evalAI;
     Trainer trainer;
     
     void UpdateScreenSize();
@@ -24,7 +24,7 @@ void TetrisUI::Update()
         else
         {
             lockDownTimer += frametime;
-            if (lockDownMove >= 15 || lockDownTimer > 0.5) LockBlock();
+            if (lockDownMove >= LOCK_DOWN_MOVES || lockDownTimer > LOCK_DOWN_DELAY) LockBlock();
         }
     }
 
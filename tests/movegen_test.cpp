@@ -0,0 +1,109 @@
+/* Checks GenerateReachable against positions worked out by hand.
+ *
+ * Boards are drawn with their bottom rows last, '#' for a filled cell.
+ * Exits with the number of failed checks, so ctest reports any of them.
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ai/movegen.hpp"
+
+static int failures = 0;
+
+static void Check(bool condition, const string& what)
+{
+    if (condition) return;
+    cerr << "FAILED: " << what << endl;
+    failures++;
+}
+
+static ColumnMasks ParseBoard(const vector<string>& rows)
+{
+    ColumnMasks cols;
+    cols.fill(FLOOR_BIT);
+
+    const int top = BOARD_HEIGHT - int(rows.size());
+    for (size_t y = 0; y < rows.size(); ++y)
+        for (int x = 0; x < BOARD_WIDTH; ++x)
+            if (rows[y][x] == '#') cols[x] |= 1u << (top + y);
+
+    return cols;
+}
+
+static const Placement* Find(const PlacementList& placements, RotateState rotation, int posX, int posY)
+{
+    for (int i = 0; i < placements.count; ++i)
+    {
+        const Placement& p = placements.items[i];
+        if (p.rotation == rotation && p.posX == posX && p.posY == posY) return &p;
+    }
+    return nullptr;
+}
+
+/* A T pointing left against the right wall, its stem resting on column 8.
+ * It only gets there by turning, so any spin depends on whether it had
+ * touched down before the turn.
+ */
+static void TestSpinNeedsTouchDown()
+{
+    const ColumnMasks cols = ParseBoard({
+        "........#.",
+        "........##",
+        "#########.",
+    });
+
+    MovementModel model;
+    model.spins = true;
+
+    PlacementList placements;
+    GenerateReachable(cols, T, placements, model);
+    const Placement* slot = Find(placements, LEFT, 8, BOARD_HEIGHT - 5);
+    Check(slot && slot->spin == T_SPIN_MINI, "T turned into the wall slot after touching down is a mini T-spin");
+
+    // No input once touched down, the turn can only happen in mid-air
+    model.lockMoves = 0;
+    GenerateReachable(cols, T, placements, model);
+    slot = Find(placements, LEFT, 8, BOARD_HEIGHT - 5);
+    Check(slot && slot->spin == NO_SPIN, "T turned into the wall slot in mid-air is no spin");
+}
+
+static bool Contains(const PlacementList& placements, const Placement& placement)
+{
+    return Find(placements, placement.rotation, placement.posX, placement.posY) != nullptr;
+}
+
+/* A plateau against the right wall, its top two rows under the spawn. With
+ * no gravity an O glides over to it; at 0.5G or 0.99G it has sunk a row
+ * by the second input and hits the plateau's side before getting there.
+ */
+static void TestSlowGravitySinks()
+{
+    const ColumnMasks cols = ParseBoard(vector<string>(BOARD_HEIGHT - 2, "........##"));
+
+    // The O covers its origin and the cells right and below, here rows 0 and 1 of columns 8 and 9
+    const Placement plateau = { INITIAL, 8, 0 };
+
+    PlacementList still, slow;
+    GenerateReachable(cols, O, still);
+    Check(Contains(still, plateau), "O reaches the plateau without gravity");
+
+    for (const auto& [gravity, name] : { pair(0.5f, "0.5G"), pair(0.99f, "0.99G") })
+    {
+        MovementModel model;
+        model.gravity = gravity;
+        GenerateReachable(cols, O, slow, model);
+
+        Check(!Contains(slow, plateau), string("O sinks before the plateau at ") + name);
+        for (int i = 0; i < slow.count; ++i)
+            Check(Contains(still, slow.items[i]), string("placements at ") + name + " also reachable without gravity");
+    }
+}
+
+int main()
+{
+    TestSpinNeedsTouchDown();
+    TestSlowGravitySinks();
+
+    if (failures == 0) cout << "movegen: all checks passed" << endl;
+    return failures;
+}